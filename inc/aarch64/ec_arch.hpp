@@ -62,6 +62,10 @@ class Ec_arch final : private Ec
         [[noreturn]]
         static void set_vmm_regs (Ec *);
 
+        bool vcpu_busy() const;
+
+        void vcpu_fini();
+
         ALWAYS_INLINE
         inline void state_load (Ec *const self, Mtd_arch mtd)
         {
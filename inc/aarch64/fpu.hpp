@@ -108,12 +108,12 @@ class Fpu final
 
         static void fini();
 
-        [[nodiscard]] static void *operator new (size_t, Slab_cache &cache) noexcept
+        [[nodiscard]] static void *operator new (size_t, Slab_account &cache) noexcept
         {
             return cache.alloc();
         }
 
-        static void operator delete (void *ptr, Slab_cache &cache)
+        static void operator delete (void *ptr, Slab_account &cache)
         {
             if (EXPECT_TRUE (ptr))
                 cache.free (ptr);
@@ -21,6 +21,7 @@
 #include "event.hpp"
 #include "intid.hpp"
 #include "macros.hpp"
+#include "timeout_interrupt.hpp"
 #include "types.hpp"
 
 class Sm;
@@ -58,8 +59,9 @@ class Interrupt final : private Intid
             RKE,
         };
 
-        Sm *            sm      { nullptr };
-        Atomic<Config>  config  { Config (0, 0, BIT (0)) };
+        Sm *                sm      { nullptr };
+        Atomic<Config>      config  { Config (0, 0, BIT (0)) };
+        Timeout_interrupt   timeout { this };
 
         static Interrupt int_table[NUM_SPI];
 
@@ -100,6 +100,8 @@ class Memattr final
             return (attr >> 4 & BIT_RANGE (3, 2)) | (attr >> 2 & BIT_RANGE (1, 0));
         }
 
+        bool operator== (Memattr const &x) const { return val == x.val; }
+
         bool valid() const { return share() != std::to_underlying (Share::RSVD) && cache_s1() != std::to_underlying (Cache::RSVD); }
 };
 
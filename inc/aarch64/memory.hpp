@@ -54,3 +54,4 @@
 #define MMAP_CPU_GICR   0x0000ff7fffe00000      // 510 511 511 000  256K
 
 #define OFFSET          (LINK_ADDR - LOAD_ADDR)
+#define LINK_END        MMAP_GLB_CPUS           // End of linear kernel memory window
@@ -34,6 +34,9 @@ class Pte : public Ptab<T, I, O>::Entry
 
         static inline void publish() { Barrier::wsb (Barrier::Domain::ISH); }
 
+        // Replacing a table descriptor with a block descriptor requires break-before-make, so leaf page tables are not promoted
+        static constexpr bool promotable { false };
+
         // Physical address size
         static inline auto pas (unsigned e)
         {
@@ -32,7 +32,7 @@ class Space_gst final : public Space_mem<Space_gst>
         static inline auto selectors() { return BIT64 (Npt::ibits - PAGE_BITS); }
         static inline auto max_order() { return Npt::lev_ord(); }
 
-        [[nodiscard]] static Space_gst *create (Status &s, Slab_cache &cache, Pd *pd)
+        [[nodiscard]] static Space_gst *create (Status &s, Slab_account &cache, Pd *pd)
         {
             // Acquire reference
             Refptr<Pd> ref_pd { pd };
@@ -50,7 +50,7 @@ class Space_gst final : public Space_mem<Space_gst>
 
                 if (EXPECT_TRUE (gst)) {
 
-                    if (EXPECT_TRUE (gst->nptp.root_init()))
+                    if (EXPECT_TRUE (gst->nptp.root_init (gst->get_quota())))
                         return gst;
 
                     operator delete (gst, cache);
@@ -66,12 +66,17 @@ class Space_gst final : public Space_mem<Space_gst>
         {
             auto &cache { get_pd()->gst_cache };
 
+            // Flush the translations tagged with the VMID before the page tables are freed
+            sync();
+
+            nptp.root_fini (get_quota());
+
             this->~Space_gst();
 
             operator delete (this, cache);
         }
 
-        auto update (uint64_t v, uint64_t p, unsigned o, Paging::Permissions pm, Memattr ma) { return nptp.update (v, p, o, pm, ma); }
+        auto update (uint64_t v, uint64_t p, unsigned o, Paging::Permissions pm, Memattr ma, bool *inv = nullptr) { return nptp.update (v, p, o, pm, ma, get_quota(), inv); }
 
         void sync() { nptp.invalidate (vmid); }
 
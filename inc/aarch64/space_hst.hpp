@@ -36,7 +36,7 @@ class Space_hst final : public Space_mem<Space_hst>
         static inline auto selectors() { return BIT64 (Npt::ibits - PAGE_BITS); }
         static inline auto max_order() { return Npt::lev_ord(); }
 
-        [[nodiscard]] static Space_hst *create (Status &s, Slab_cache &cache, Pd *pd)
+        [[nodiscard]] static Space_hst *create (Status &s, Slab_account &cache, Pd *pd)
         {
             // Acquire reference
             Refptr<Pd> ref_pd { pd };
@@ -54,7 +54,7 @@ class Space_hst final : public Space_mem<Space_hst>
 
                 if (EXPECT_TRUE (hst)) {
 
-                    if (EXPECT_TRUE (hst->nptp.root_init()))
+                    if (EXPECT_TRUE (hst->nptp.root_init (hst->get_quota())))
                         return hst;
 
                     operator delete (hst, cache);
@@ -70,14 +70,21 @@ class Space_hst final : public Space_mem<Space_hst>
         {
             auto &cache { get_pd()->hst_cache };
 
+            // Flush the translations tagged with the VMID before the page tables are freed
+            sync();
+
+            nptp.root_fini (get_quota());
+
             this->~Space_hst();
 
             operator delete (this, cache);
         }
 
+        bool busy() const { return false; }
+
         auto lookup (uint64_t v, uint64_t &p, unsigned &o, Memattr &ma) const { return nptp.lookup (v, p, o, ma); }
 
-        auto update (uint64_t v, uint64_t p, unsigned o, Paging::Permissions pm, Memattr ma) { return nptp.update (v, p, o, pm, ma); }
+        auto update (uint64_t v, uint64_t p, unsigned o, Paging::Permissions pm, Memattr ma, bool *inv = nullptr) { return nptp.update (v, p, o, pm, ma, get_quota(), inv); }
 
         void sync() { nptp.invalidate (vmid); }
 
@@ -24,7 +24,7 @@ class Space_msr final : public Space
     public:
         [[nodiscard]] auto delegate (Space_msr const *, unsigned long, unsigned long, unsigned, unsigned) { return Status::BAD_FTR; };
 
-        [[nodiscard]] static Space_msr *create (Status &s, Slab_cache &, Pd *)
+        [[nodiscard]] static Space_msr *create (Status &s, Slab_account &, Pd *)
         {
             s = Status::BAD_FTR;
 
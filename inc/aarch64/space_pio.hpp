@@ -24,7 +24,7 @@ class Space_pio final : public Space
     public:
         [[nodiscard]] auto delegate (Space_pio const *, unsigned long, unsigned long, unsigned, unsigned) { return Status::BAD_FTR; };
 
-        [[nodiscard]] static Space_pio *create (Status &s, Slab_cache &, Pd *, bool)
+        [[nodiscard]] static Space_pio *create (Status &s, Slab_account &, Pd *, bool)
         {
             s = Status::BAD_FTR;
 
@@ -0,0 +1,70 @@
+/*
+ * String Functions: Architecture-Specific Part (ARM)
+ *
+ * Copyright (C) 2019-2024 Udo Steinberg, BedRock Systems, Inc.
+ *
+ * This file is part of the NOVA microhypervisor.
+ *
+ * NOVA is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NOVA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License version 2 for more details.
+ */
+
+#pragma once
+
+#include "compiler.hpp"
+#include "macros.hpp"
+#include "types.hpp"
+
+extern "C" NONNULL
+inline void *memcpy (void *d, void const *s, size_t n)
+{
+    auto dst { static_cast<char *>(d) };
+    auto src { static_cast<char const *>(s) };
+
+    while (n--)
+        *dst++ = *src++;
+
+    return d;
+}
+
+extern "C" NONNULL
+inline void *memset (void *d, int c, size_t n)
+{
+    auto dst { static_cast<char *>(d) };
+
+    while (n--)
+        *dst++ = static_cast<char>(c);
+
+    return d;
+}
+
+/*
+ * Zero whole pages with DC ZVA, which does not fetch the lines it zeroes
+ *
+ * @param d     Page-aligned pointer to the region
+ * @param n     Size of the region (multiple of the page size)
+ */
+extern "C" NONNULL
+inline void *memzero (void *d, size_t n)
+{
+    uint64_t dczid;
+
+    asm volatile ("mrs %x0, dczid_el0" : "=r" (dczid));
+
+    // DC ZVA is prohibited
+    if (EXPECT_FALSE (dczid & BIT (4)))
+        return memset (d, 0, n);
+
+    auto const b { 4UL << (dczid & BIT_RANGE (3, 0)) };
+
+    for (auto dst { static_cast<char *>(d) }; n; n -= b, dst += b)
+        asm volatile ("dc zva, %x0" : : "r" (dst) : "memory");
+
+    return d;
+}
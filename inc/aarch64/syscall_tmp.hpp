@@ -19,3 +19,5 @@
 
 template void Ec::send_msg<Ec_arch::ret_user_exception> (Ec *);
 template void Ec::send_msg<Ec_arch::ret_user_vmexit> (Ec *);
+
+template void Ec::sys_finish<Status::SUCCESS, true> (Ec *);
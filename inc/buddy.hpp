@@ -22,12 +22,27 @@
 #pragma once
 
 #include "arch.hpp"
+#include "atomic.hpp"
 #include "memory.hpp"
 #include "queue.hpp"
 #include "spinlock.hpp"
+#include "std.hpp"
 
 class Buddy final
 {
+    public:
+        /*
+         * Allocation groups
+         *
+         * Each superpage-sized region of the pool serves one group at a time, so that
+         * short-lived page tables do not fragment regions that hold long-lived objects.
+         */
+        enum class Group : uint8_t
+        {
+            OBJ,        // Kernel objects, slabs, capability tables (long-lived)
+            PTAB,       // Page tables (short-lived)
+        };
+
     private:
         using order_t = uint8_t;
         using index_t = unsigned long;
@@ -35,6 +50,8 @@ class Buddy final
         // Valid orders range from 0 (PAGE_SIZE) to PTE_BPL (SUPERPAGE_SIZE)
         static constexpr order_t orders { PTE_BPL + 1 };
 
+        static constexpr unsigned groups { 2 };
+
         class Block final : public Queue<Block>::Element
         {
             public:
@@ -46,46 +63,117 @@ class Buddy final
 
                 order_t ord { 0 };
                 Tag     tag { Tag::USED };
+                Group   grp { Group::OBJ };     // Region group (valid in the first block of a region)
         };
 
         class Freelist final
         {
             private:
-                Queue<Block> list[orders];
+                Queue<Block> list[groups][orders - 1];  // Blocks in regions of a group
+                Queue<Block> free;                      // Free regions
+                unsigned     num[groups + 1][orders];   // Statistics
+
+                auto &queue (order_t o, Group g) { return o == orders - 1 ? free : list[std::to_underlying (g)][o]; }
+                auto &count (order_t o, Group g) { return num[o == orders - 1 ? groups : std::to_underlying (g)][o]; }
 
             public:
-                void enqueue (Block *b) { list[b->ord].enqueue_head (b); }
-                void dequeue (Block *b) { list[b->ord].dequeue (b); }
-                auto dequeue (order_t o) { return list[o].dequeue_head(); }
+                void enqueue (Block *b, Group g) { queue (b->ord, g).enqueue_head (b); count (b->ord, g)++; }
+                void dequeue (Block *b, Group g) { queue (b->ord, g).dequeue (b); count (b->ord, g)--; }
+
+                auto dequeue (order_t o, Group g)
+                {
+                    auto const b { queue (o, g).dequeue_head() };
+
+                    if (b)
+                        count (o, g)--;
+
+                    return b;
+                }
+
+                auto blocks (unsigned g, order_t o) const { return num[g][o]; }
         };
 
+    public:
+        /*
+         * List of blocks awaiting a deferred free
+         *
+         * The list is linked through the block array, not through the memory
+         * itself, which may remain visible to other cores until it is freed.
+         */
         class Waitlist final
         {
+            friend class Buddy;
+
             private:
                 Queue<Block> list;
 
-            public:
                 void enqueue (Block *b) { list.enqueue_head (b); }
                 auto dequeue()          { return list.dequeue_head(); }
         };
 
-        static inline Spinlock      lock;       // Allocator Spinlock
-        static inline index_t       min_idx;    // Minimum Block Index
-        static inline index_t       max_idx;    // Maximum Block Index
-        static inline uintptr_t     mem_base;   // Base of Memory Pool
-        static inline Block *       blk_base;   // Base of Block Array
-        static inline Freelist      freelist;   // Block Freelist
+    private:
+        /*
+         * Memory pool
+         *
+         * A physically contiguous range of kernel memory with a block array at its end.
+         * The block array also covers the superpage that contains the first valid page.
+         * A pool with max_idx == 0 is unused.
+         */
+        struct Pool
+        {
+            index_t     min_idx;        // Minimum Block Index
+            Block *     blk_base;       // Base of Block Array
 
-        static Waitlist waitlist    CPULOCAL;   // Block Waitlist (per Core)
+            // Maximum Block Index, published last, which makes the other fields valid
+            Atomic<index_t, __ATOMIC_ACQUIRE, __ATOMIC_RELEASE> max_idx;
 
-        static bool valid (index_t x) { return x >= min_idx && x < max_idx; }
+            auto base_idx() const { return min_idx & ~(BIT (orders - 1) - 1); }
+
+            bool valid    (index_t x)       const { auto const m { max_idx.load() }; return x >= min_idx    && x < m; }
+            bool contains (index_t x)       const { auto const m { max_idx.load() }; return x >= base_idx() && x < m; }
+            bool contains (Block const *b)  const { auto const m { max_idx.load() }; return b >= blk_base + base_idx() && b < blk_base + m; }
+        };
 
-        static auto index_to_block (index_t x)  { return blk_base + x; }
-        static auto block_to_index (Block *x)   { return static_cast<index_t>(x - blk_base); }
+        static constexpr unsigned pools { 16 };
+
+        static inline Spinlock      lock;           // Allocator Spinlock
+        static inline Spinlock      pool_lock;      // Pool Table Spinlock
+        static inline uintptr_t     mem_base;       // Base of Memory Pools
+        static inline Pool          pool[pools];    // Memory Pools (Boot Pool First)
+        static inline Atomic<unsigned, __ATOMIC_ACQUIRE, __ATOMIC_RELEASE> used { 1 };    // Pool Slots Ever Used
+        static inline Freelist      freelist;       // Block Freelist
+        static inline uint64_t      ticks;          // Initialization Time
+
+        static Waitlist waitlist    CPULOCAL;       // Block Waitlist (per Core)
+
+        template <typename T>
+        static Pool const *find (T x)
+        {
+            // Most blocks belong to the boot pool
+            if (EXPECT_TRUE (pool[0].contains (x)))
+                return pool;
+
+            for (auto p { pool + 1 }; p < pool + used; p++)
+                if (p->contains (x))
+                    return p;
+
+            return nullptr;
+        }
+
+        static bool valid (index_t x) { auto const p { find (x) }; return p && p->valid (x); }
+
+        static auto index_to_block (index_t x)  { return find (x)->blk_base + x; }
+        static auto block_to_index (Block *x)   { return static_cast<index_t>(x - find (x)->blk_base); }
 
         static auto index_to_page (index_t x)   { return mem_base + x * PAGE_SIZE (0); }
         static auto page_to_index (uintptr_t x) { return static_cast<index_t>((x - mem_base) / PAGE_SIZE (0)); }
 
+        static auto region (Block *x)           { return index_to_block (block_to_index (x) & ~(BIT (orders - 1) - 1)); }
+
+        static Block *take (order_t, Group);
+
+        static void insert (index_t, index_t);
+
         NONNULL static void coalesce (Block *);
 
     public:
@@ -98,10 +186,23 @@ class Buddy final
 
         static void init();
 
-        [[nodiscard]] static void *alloc (order_t, Fill = Fill::NONE);
+        static auto init_ticks() { return ticks; }
+
+        [[nodiscard]] static void *alloc (order_t, Fill = Fill::NONE, Group = Group::OBJ);
+
+        [[nodiscard]] static unsigned alloc_batch (void **, unsigned, Group = Group::OBJ);
 
         static void free (void *);
         static void wait (void *);
 
+        static void wait (void *, Waitlist &);
+
+        [[nodiscard]] static void *unwait (Waitlist &);
+
+        static bool donate  (uint64_t, size_t);
+        static bool reclaim (uint64_t);
+
+        static void stats();
+
         static void free_wait() { for (Block *b; (b = waitlist.dequeue()); coalesce (b)); }
 };
@@ -180,8 +180,8 @@ class Capability final
             // Must not be a null capability
             assert (o);
 
-            // Release reference
-            auto const r { o->ref_dec() };
+            // Release reference without deferring destruction, the caller destroys the object
+            auto const r { o->Refcnt::ref_dec() };
 
             // Reference count 1 -> 0 because nobody has seen the object yet
             assert (r == 0);
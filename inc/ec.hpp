@@ -39,21 +39,32 @@ class Utcb;
 class Ec : public Kobject, private Queue<Sc>, public Queue<Ec>::Element
 {
     friend class Ec_arch;
+    friend class Sc;
+    friend class Sm;
     friend class Tlb;
 
     private:
         using cont_t = void (*)(Ec *);  // Continuation Type
 
-        Cpu_regs            regs;
+        // Read-mostly
         unsigned long const evt;
         cpu_t         const cpu;
         Fpu *         const fpu;
         void *        const kpage;
+
+        // Written by remote cores (unblock, SC donation, timeouts)
+        alignas (Kobject::alignment_mp)
+        Atomic<cont_t>      cont        { nullptr };
+        Spinlock            lock;
+        uint8_t             prio        { 0 };
         Ec *                callee      { nullptr };
         Ec *                caller      { nullptr };
-        Atomic<cont_t>      cont        { nullptr };
         Timeout_hypercall   timeout     { this };
-        Spinlock            lock;
+
+        // Written by the owning core on every kernel entry/exit
+        alignas (Kobject::alignment_mp)
+        Cpu_regs            regs;
+        Sm *                consumed    { nullptr };    // Group member consumed by the most recent down on a group
 
         static Atomic<Ec *> current asm ("current") CPULOCAL;
         static Ec *         fpowner                 CPULOCAL;
@@ -171,14 +182,14 @@ class Ec : public Kobject, private Queue<Sc>, public Queue<Ec>::Element
         void sys_finish_status (Status);
 
         // Constructor: Kernel Thread
-        Ec (Refptr<Space_obj> &ref_obj, Refptr<Space_hst> &ref_hst, Refptr<Space_pio> &ref_pio, cpu_t c, cont_t x) : Kobject (Kobject::Type::EC, Kobject::Subtype::EC_GLOBAL), regs (ref_obj, ref_hst, ref_pio), evt (0), cpu (c), fpu (nullptr), kpage (nullptr), cont (x) { ref_inc(); }
+        Ec (Refptr<Space_obj> &ref_obj, Refptr<Space_hst> &ref_hst, Refptr<Space_pio> &ref_pio, cpu_t c, cont_t x) : Kobject (Kobject::Type::EC, Kobject::Subtype::EC_GLOBAL), evt (0), cpu (c), fpu (nullptr), kpage (nullptr), cont (x), regs (ref_obj, ref_hst, ref_pio) { ref_inc(); }
 
         // Constructor: HST EC
-        Ec (bool t, Fpu *f, Refptr<Space_obj> &ref_obj, Refptr<Space_hst> &ref_hst, Refptr<Space_pio> &ref_pio, void *k, cpu_t c, unsigned long e, cont_t x) : Kobject (Kobject::Type::EC, t ? Kobject::Subtype::EC_GLOBAL : Kobject::Subtype::EC_LOCAL), regs (ref_obj, ref_hst, ref_pio), evt (e), cpu (c), fpu (f), kpage (k), cont (x) {}
+        Ec (bool t, Fpu *f, Refptr<Space_obj> &ref_obj, Refptr<Space_hst> &ref_hst, Refptr<Space_pio> &ref_pio, void *k, cpu_t c, unsigned long e, cont_t x) : Kobject (Kobject::Type::EC, t ? Kobject::Subtype::EC_GLOBAL : Kobject::Subtype::EC_LOCAL), evt (e), cpu (c), fpu (f), kpage (k), cont (x), regs (ref_obj, ref_hst, ref_pio) {}
 
         // Constructor: GST EC
         template <typename T>
-        Ec (bool t, Fpu *f, Refptr<Space_obj> &ref_obj, Refptr<Space_hst> &ref_hst, T *v, void *k, cpu_t c, unsigned long e, cont_t x) : Kobject (Kobject::Type::EC, t ? Kobject::Subtype::EC_VCPU_OFFS : Kobject::Subtype::EC_VCPU_REAL), regs (ref_obj, ref_hst, v), evt (e), cpu (c), fpu (f), kpage (k), cont (x) {}
+        Ec (bool t, Fpu *f, Refptr<Space_obj> &ref_obj, Refptr<Space_hst> &ref_hst, T *v, void *k, cpu_t c, unsigned long e, cont_t x) : Kobject (Kobject::Type::EC, t ? Kobject::Subtype::EC_VCPU_OFFS : Kobject::Subtype::EC_VCPU_REAL), evt (e), cpu (c), fpu (f), kpage (k), cont (x), regs (ref_obj, ref_hst, v) {}
 
     public:
         // Factory: Kernel Thread
@@ -190,12 +201,11 @@ class Ec : public Kobject, private Queue<Sc>, public Queue<Ec>::Element
         // Factory: GST EC
         [[nodiscard]] static Ec *create_gst (Status &s, Pd *, bool, bool, cpu_t, unsigned long, uintptr_t, uintptr_t);
 
-        void destroy()
-        {
-            this->~Ec();
+        bool kpage_mapped (uintptr_t) const;
 
-            operator delete (this, cache);
-        }
+        void destroy();
+
+        bool busy();
 
         static void create_idle();
         static void create_root();
@@ -260,13 +270,24 @@ class Ec : public Kobject, private Queue<Sc>, public Queue<Ec>::Element
         }
 
         ALWAYS_INLINE
-        void unblock_sc()
+        void unblock_sc (bool direct = false)
         {
             Lock_guard <Spinlock> guard { lock };
 
-            for (Sc *sc; (sc = dequeue_head()); Scheduler::unblock (sc)) ;
+            for (Sc *sc; (sc = dequeue_head()); Scheduler::unblock (sc, direct)) ;
         }
 
+        /*
+         * Record the priority of the current SC before the EC blocks
+         *
+         * @return      Priority of the current SC
+         */
+        ALWAYS_INLINE
+        inline auto set_prio() { return prio = Scheduler::get_current()->get_prio(); }
+
+        ALWAYS_INLINE
+        inline auto get_prio() const { return prio; }
+
         ALWAYS_INLINE
         inline void set_timeout (uint64_t t, Sm *s)
         {
@@ -287,5 +308,8 @@ class Ec : public Kobject, private Queue<Sc>, public Queue<Ec>::Element
         [[noreturn]] NOINLINE
         static void sys_finish (Ec *);
 
+        [[noreturn]] NOINLINE
+        static void sys_ctrl_sm_retry (Ec *);
+
         static cont_t const syscall[16] asm ("syscall");
 };
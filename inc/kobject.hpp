@@ -22,6 +22,7 @@
 #pragma once
 
 #include "macros.hpp"
+#include "rcu.hpp"
 #include "refcnt.hpp"
 #include "slab.hpp"
 
@@ -30,7 +31,8 @@ class Kobject : public Refcnt
     friend class Capability;
 
     public:
-        static constexpr auto alignment { BIT (5) };
+        static constexpr auto alignment     { BIT (5) };
+        static constexpr auto alignment_mp  { BIT (6) };    // Objects accessed by multiple cores (cache line)
 
         enum class Type : uint8_t
         {
@@ -59,6 +61,28 @@ class Kobject : public Refcnt
             MSR             = 6,
         };
 
+    private:
+        /*
+         * RCU element for deferred destruction
+         *
+         * The element is a member rather than a base class, because Rcu_elem::next
+         * would otherwise be ambiguous with Queue<T>::Element::next in SC, EC and SM.
+         */
+        class Reclaim final : public Rcu_elem
+        {
+            private:
+                Kobject * const obj;
+
+                static void reclaim (Rcu_elem *);
+
+            public:
+                explicit Reclaim (Kobject *o) : Rcu_elem { reclaim }, obj { o } {}
+        };
+
+        Reclaim reclaim { this };
+
+        bool destroy_quiescent();
+
     protected:
         Type    const   type;
         Subtype const   subtype;
@@ -75,4 +99,33 @@ class Kobject : public Refcnt
             if (EXPECT_TRUE (ptr))
                 cache.free (ptr);
         }
+
+        [[nodiscard]] static void *operator new (size_t, Slab_account &cache) noexcept
+        {
+            return cache.alloc();
+        }
+
+        static void operator delete (void *ptr, Slab_account &cache)
+        {
+            if (EXPECT_TRUE (ptr))
+                cache.free (ptr);
+        }
+
+    public:
+        /*
+         * Release a reference and defer the destruction of the object past an RCU
+         * grace period if that was the last reference, because a concurrent reader
+         * may still be using the object without holding a reference
+         *
+         * @return      Remaining reference count
+         */
+        auto ref_dec()
+        {
+            auto const r { Refcnt::ref_dec() };
+
+            if (EXPECT_FALSE (!r))
+                Rcu::submit (&reclaim);
+
+            return r;
+        }
 };
@@ -42,31 +42,70 @@ class Pd final : public Kobject
 {
     private:
         Atomic<unsigned>    spaces      { 0 };
+        Quota               quota;
         Atomic<Space_obj *> space_obj   { nullptr };
         Atomic<Space_hst *> space_hst   { nullptr };
         Atomic<Space_pio *> space_pio   { nullptr };
+        Refptr<Pd> const    owner;                  // PD charged for this PD
 
-        Pd();
+        Pd (Refptr<Pd> &);
 
         auto attach (Kobject::Subtype s) { return !spaces.test_and_set (BIT (std::to_underlying (s))); }
         void detach (Kobject::Subtype s) { spaces &= ~BIT (std::to_underlying (s)); }
 
+        template <typename T>
+        bool unpublish (Atomic<T *> &p, T *o, Kobject::Subtype s)
+        {
+            if (p != o)
+                return false;
+
+            p = nullptr;
+
+            detach (s);
+
+            return true;
+        }
+
         static Slab_cache cache;
 
     public:
-        Slab_cache dma_cache;
-        Slab_cache gst_cache;
-        Slab_cache hst_cache;
-        Slab_cache msr_cache;
-        Slab_cache obj_cache;
-        Slab_cache pio_cache;
-        Slab_cache fpu_cache;
+        Slab_account dma_cache;
+        Slab_account gst_cache;
+        Slab_account hst_cache;
+        Slab_account msr_cache;
+        Slab_account obj_cache;
+        Slab_account pio_cache;
+        Slab_account fpu_cache;
+        Slab_account ec_cache;
+        Slab_account pd_cache;
+        Slab_account pt_cache;
+        Slab_account sc_cache;
+        Slab_account sm_cache;
 
         static inline Pd *root { nullptr };
 
-        [[nodiscard]] static auto create (Status &s)
+        /*
+         * Create a PD
+         *
+         * @param s     Status (set on failure)
+         * @param o     PD charged for the new PD (or nullptr for a kernel-owned PD)
+         * @return      Pointer to the PD (or nullptr on failure)
+         */
+        [[nodiscard]] static Pd *create (Status &s, Pd *o = nullptr)
         {
-            auto const pd { new (cache) Pd };
+            // Acquire reference
+            Refptr<Pd> ref_pd { o };
+
+            // Failed to acquire reference
+            if (EXPECT_FALSE (o && !ref_pd)) {
+                s = Status::ABORTED;
+                return nullptr;
+            }
+
+            auto const pd { o ? new (o->pd_cache) Pd { ref_pd } : new (cache) Pd { ref_pd } };
+
+            // If we created pd, then reference must have been consumed
+            assert (!pd || !ref_pd);
 
             if (EXPECT_FALSE (!pd))
                 s = Status::MEM_OBJ;
@@ -76,15 +115,33 @@ class Pd final : public Kobject
 
         void destroy()
         {
+            // The owner outlives this call, because its destruction is deferred past a grace period
+            auto const o { static_cast<Pd *>(owner) };
+
             this->~Pd();
 
-            operator delete (this, cache);
+            if (o)
+                operator delete (this, o->pd_cache);
+            else
+                operator delete (this, cache);
         }
 
         Space_obj *get_obj() const { return space_obj; }
         Space_hst *get_hst() const { return space_hst; }
         Space_pio *get_pio() const { return space_pio; }
 
+        auto &get_quota() { return quota; }
+
+        /*
+         * Unpublish a space whose last reference was dropped
+         *
+         * @param o     Space to unpublish
+         * @return      True if the space was published by this PD, false otherwise
+         */
+        bool unpublish (Space_obj *o) { return unpublish (space_obj, o, Kobject::Subtype::OBJ); }
+        bool unpublish (Space_hst *o) { return unpublish (space_hst, o, Kobject::Subtype::HST); }
+        bool unpublish (Space_pio *o) { return unpublish (space_pio, o, Kobject::Subtype::PIO); }
+
         Space_dma *create_dma (Status &, Space_obj *, unsigned long);
         Space_gst *create_gst (Status &, Space_obj *, unsigned long);
         Space_hst *create_hst (Status &, Space_obj *, unsigned long);
@@ -96,5 +153,5 @@ class Pd final : public Kobject
         static Ec *create_ec (Status &, Space_obj *, unsigned long, Pd *, cpu_t, uintptr_t, uintptr_t, uintptr_t, uint8_t);
         static Sc *create_sc (Status &, Space_obj *, unsigned long, Ec *, cpu_t, uint16_t, uint8_t, uint16_t);
         static Pt *create_pt (Status &, Space_obj *, unsigned long, Ec *, uintptr_t);
-        static Sm *create_sm (Status &, Space_obj *, unsigned long, uint64_t, unsigned = ~0U);
+        static Sm *create_sm (Status &, Space_obj *, unsigned long, uint64_t, unsigned = ~0U, uint8_t = 0);
 };
@@ -31,27 +31,29 @@ class Pt final : public Kobject
         uintptr_t  const    ip;
         Atomic<uintptr_t>   id      { 0 };
         Atomic<Mtd_arch>    mtd     { Mtd_arch { 0 } };
+        Refptr<Pd> const    owner;                  // PD charged for this PT
 
         static Slab_cache   cache;
 
-        Pt (Refptr<Ec>&, uintptr_t);
+        Pt (Refptr<Pd>&, Refptr<Ec>&, uintptr_t);
 
     public:
-        [[nodiscard]] static Pt *create (Status &s, Ec *ec, uintptr_t ip)
+        [[nodiscard]] static Pt *create (Status &s, Pd *pd, Ec *ec, uintptr_t ip)
         {
-            // Acquire reference
+            // Acquire references
+            Refptr<Pd> ref_pd { pd };
             Refptr<Ec> ref_ec { ec };
 
-            // Failed to acquire reference
-            if (EXPECT_FALSE (!ref_ec))
+            // Failed to acquire references
+            if (EXPECT_FALSE ((pd && !ref_pd) || !ref_ec))
                 s = Status::ABORTED;
 
             else {
 
-                auto const pt { new (cache) Pt { ref_ec, ip } };
+                auto const pt { pd ? new (pd->pt_cache) Pt { ref_pd, ref_ec, ip } : new (cache) Pt { ref_pd, ref_ec, ip } };
 
-                // If we created pt, then reference must have been consumed
-                assert (!pt || !ref_ec);
+                // If we created pt, then references must have been consumed
+                assert (!pt || (!ref_pd && !ref_ec));
 
                 if (EXPECT_TRUE (pt))
                     return pt;
@@ -64,9 +66,14 @@ class Pt final : public Kobject
 
         void destroy()
         {
+            auto const pd { static_cast<Pd *>(owner) };
+
             this->~Pt();
 
-            operator delete (this, cache);
+            if (pd)
+                operator delete (this, pd->pt_cache);
+            else
+                operator delete (this, cache);
         }
 
         Ec *get_ec() const { return ec; }
@@ -28,6 +28,8 @@
 #include "kmem.hpp"
 #include "memattr.hpp"
 #include "paging.hpp"
+#include "ptab_cache.hpp"
+#include "quota.hpp"
 #include "status.hpp"
 #include "util.hpp"
 
@@ -78,9 +80,28 @@ class Ptab
 
         Paging::Permissions lookup (IAddr, OAddr &, unsigned &, Memattr &) const;
 
-        Status update (IAddr, OAddr, unsigned, Paging::Permissions, Memattr);
+        void census (IAddr, IAddr, unsigned *) const;
 
-        [[nodiscard]] inline auto root_init (unsigned l = T::lev() - 1) { return walk (0, l, true); }
+        Status update (IAddr, OAddr, unsigned, Paging::Permissions, Memattr, Quota * = nullptr, bool * = nullptr);
+
+        [[nodiscard]] inline auto root_init (unsigned l = T::lev() - 1, Quota *q = nullptr) { return walk (0, l, true, q); }
+
+        [[nodiscard]] inline auto root_init (Quota *q) { return root_init (T::lev() - 1, q); }
+
+        /*
+         * Deallocate the page table tree of a space that is no longer in use
+         *
+         * @param q     Quota to uncharge (or nullptr for none)
+         */
+        inline void root_fini (Quota *q)
+        {
+            auto const e { static_cast<Entry>(entry) };
+
+            if (e.val)
+                e->deallocate (T::lev() - 1, q, true);
+
+            entry = Entry (0);
+        }
 
         ALWAYS_INLINE
         inline auto root_addr() const
@@ -99,32 +120,96 @@ class Ptab
 
         Ptab (Entry e) : entry (e) {}
 
-        [[nodiscard]] PTE *walk (IAddr, unsigned, bool);
+        [[nodiscard]] inline auto walk (IAddr v, unsigned t, bool e, Quota *q = nullptr) { return walk (&entry, T::lev(), v, t, e, q); }
 
     private:
         // Maximum leaf level: 3 (512GB), 2 (1GB), 1 (2MB), 0 (4KB)
         static inline unsigned mll { 2 };
 
+        // Page tables are allocated zeroed, so only large-page splinters need their entries written
         ALWAYS_INLINE
         inline Ptab (unsigned n, OAddr p, OAddr s)
         {
-            for (unsigned i { 0 }; i < n; i++, p += s)
+            for (unsigned i { 0 }; p && i < n; i++, p += s)
                 this[i].entry = Entry (p);
 
             // Ensure PTE observability
             T::noncoherent ? Cache::data_clean (this, n * sizeof (entry)) : T::publish();
         }
 
-        void deallocate (unsigned);
+        [[nodiscard]] PTE *walk (PTE *, unsigned, IAddr, unsigned, bool, Quota *);
+
+        void deallocate (unsigned, Quota *, bool = false);
+
+        bool promote (PTE *, Quota *);
+
+        static bool replace (PTE *, T &, T, unsigned, bool);
+
+        static bool replaced (PTE *, PTE *);
+
+        /*
+         * Determine if a PTE refers to a page table that is being promoted
+         *
+         * The lock bit is only meaningful in PTEs that refer to a leaf page table,
+         * because leaf PTEs use the same bit for the protection key.
+         *
+         * @param pte   PTE
+         * @param l     Level of the PTE
+         * @return      True if the PTE is locked, false otherwise
+         */
+        static bool locked (T pte, unsigned l)
+        {
+            if constexpr (T::promotable)
+                return l == 1 && pte.type (l) == Entry::Type::PTAB && pte.val & T::lock;
+
+            return false;
+        }
+
+        /*
+         * Determine if a PTE refers to a kernel page owned by the space (UTCB or vAPIC page)
+         *
+         * @param pte   PTE
+         * @param l     Level of the PTE
+         * @return      True if the PTE maps a writable kernel page, false otherwise
+         */
+        static bool kernel (T pte, unsigned l)
+        {
+            return pte.type (l) == Entry::Type::LEAF && (pte.page_pm() & (Paging::K | Paging::W)) == (Paging::K | Paging::W);
+        }
+
+        /*
+         * Determine if replacing an old PTE with a new PTE can leave harmful stale translations
+         *
+         * @param o     Old PTE
+         * @param n     New PTE
+         * @param l     Level of both PTEs
+         * @return      False if the new PTE is a superset of the old PTE, true otherwise
+         */
+        static bool downgrade (T o, T n, unsigned l)
+        {
+            switch (o.type (l)) {
+                case Entry::Type::HOLE: return false;
+                case Entry::Type::PTAB: return true;
+                default: break;
+            }
+
+            return n.type (l) != Entry::Type::LEAF || n.addr (l) != o.addr (l) || !(n.page_ma (l) == o.page_ma (l)) || o.page_pm() & ~n.page_pm();
+        }
+
+        // Only leaf page tables of spaces with a quota are promoted, because kernel page tables are shared by level
+        static inline bool promotable (unsigned l, Quota *q) { return T::promotable && !l && mll && q; }
 
         [[nodiscard]] static inline void *operator new (size_t, unsigned o) noexcept
         {
-            return Buddy::alloc (static_cast<uint8_t>(o));
+            return o ? Buddy::alloc (static_cast<uint8_t>(o), Buddy::Fill::BITS0, Buddy::Group::PTAB) : Ptab_cache::alloc();
         }
 
         NONNULL ALWAYS_INLINE
-        static inline void operator delete (void *ptr, bool wait)
+        static inline void operator delete (void *ptr, unsigned o, bool wait)
         {
-            wait ? Buddy::wait (ptr) : Buddy::free (ptr);
+            if (o)
+                wait ? Buddy::wait (ptr) : Buddy::free (ptr);
+            else
+                wait ? Ptab_cache::wait (ptr) : Ptab_cache::free (ptr);
         }
 };
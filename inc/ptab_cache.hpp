@@ -0,0 +1,54 @@
+/*
+ * Page-Table Page Cache
+ *
+ * Copyright (C) 2019-2024 Udo Steinberg, BedRock Systems, Inc.
+ *
+ * This file is part of the NOVA microhypervisor.
+ *
+ * NOVA is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NOVA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License version 2 for more details.
+ */
+
+#pragma once
+
+#include "buddy.hpp"
+#include "compiler.hpp"
+
+/*
+ * Per-core cache of zeroed order-0 page-table pages
+ *
+ * The cache is refilled from the buddy allocator in batches, so that building
+ * page tables does not take the global allocator lock for every table. It is
+ * only used after bootstrap, when CPU-local memory is active.
+ */
+class Ptab_cache final
+{
+    private:
+        static constexpr unsigned size  { 32 };     // Cache Capacity
+        static constexpr unsigned batch { 8 };      // Pages per Refill
+
+        static void *   page[size]  CPULOCAL;       // Zeroed Pages
+        static unsigned num         CPULOCAL;       // Number of Zeroed Pages
+        static Buddy::Waitlist list CPULOCAL;       // Pages Awaiting TLB Invalidation
+
+    public:
+        class Retired;
+
+        [[nodiscard]] static void *alloc();
+
+        static void free (void *);
+        static void wait (void *);
+
+        [[nodiscard]] static Retired *prepare (void *);
+
+        static void retire (Retired *);
+        static void cancel (Retired *);
+
+        static void free_wait();
+};
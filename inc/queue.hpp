@@ -84,6 +84,42 @@ class Queue
             return false;
         }
 
+        /*
+         * Enqueue element into this queue in priority order
+         *
+         * Elements with equal priority are enqueued in FIFO order.
+         *
+         * @param e     Element to enqueue
+         * @param prio  Function that returns the priority of an element
+         * @return      True if the queue was empty, false otherwise
+         */
+        template <typename F>
+        ALWAYS_INLINE NONNULL
+        inline bool enqueue_prio (T *e, F const &prio)
+        {
+            if (!head)
+                return enqueue (e, true);
+
+            auto const p { prio (e) };
+            auto n { head };
+
+            // Find the first element with a lower priority (or wrap around to the tail)
+            while (prio (static_cast<T *>(n)) >= p)
+                if ((n = n->next) == head)
+                    break;
+
+            assert (!e->queued());
+
+            e->next = n;
+            e->prev = n->prev;
+            e->next->prev = e->prev->next = e;
+
+            if (n == head && prio (static_cast<T *>(head)) < p)
+                head = e;
+
+            return false;
+        }
+
         ALWAYS_INLINE NONNULL
         inline auto enqueue_head (T *e) { return enqueue (e, true); }
 
@@ -113,6 +149,14 @@ class Queue
             e->next = e->prev = nullptr;
         }
 
+        /*
+         * Return head element of this queue without dequeuing it
+         *
+         * @return      Head element or nullptr
+         */
+        ALWAYS_INLINE
+        inline auto peek_head() const { return static_cast<T *>(head); }
+
         /*
          * Dequeue head element from this queue
          *
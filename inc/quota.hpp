@@ -0,0 +1,57 @@
+/*
+ * Kernel Memory Quota
+ *
+ * Copyright (C) 2019-2024 Udo Steinberg, BedRock Systems, Inc.
+ *
+ * This file is part of the NOVA microhypervisor.
+ *
+ * NOVA is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NOVA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License version 2 for more details.
+ */
+
+#pragma once
+
+#include "atomic.hpp"
+#include "compiler.hpp"
+#include "types.hpp"
+
+class Quota final
+{
+    private:
+        Atomic<size_t>  used    { 0 };          // Charged Memory
+        Atomic<size_t>  limit   { ~0UL };       // Memory Limit
+
+    public:
+        /*
+         * Charge memory against this quota
+         *
+         * @param s     Size of the memory in bytes
+         * @return      True if successful, false if the limit would be exceeded
+         */
+        [[nodiscard]] bool charge (size_t s)
+        {
+            for (auto o { used.load() }; o + s <= limit; )
+                if (EXPECT_TRUE (used.compare_exchange_n (o, o + s)))
+                    return true;
+
+            return false;
+        }
+
+        /*
+         * Uncharge memory from this quota
+         *
+         * @param s     Size of the memory in bytes
+         */
+        void uncharge (size_t s) { used -= s; }
+
+        auto get_used() const { return used.load(); }
+        auto get_limit() const { return limit.load(); }
+
+        void set_limit (size_t l) { limit = l; }
+};
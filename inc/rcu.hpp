@@ -60,6 +60,16 @@ class Rcu
                    *tail = e;
                     tail = &e->next;
                 }
+
+                Rcu_elem *dequeue()
+                {
+                    auto const e { head };
+
+                    if (e && !(head = e->next))
+                        tail = &head;
+
+                    return e;
+                }
         };
 
         using Epoch = unsigned long;
@@ -77,15 +87,29 @@ class Rcu
         // Number of CPUs that still need to pass through a quiescent state in epoch E
         static inline Atomic<cpu_t, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST> count { 0 };
 
+        // Grace periods are expedited until epoch T has completed
+        static inline Atomic<Epoch, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST> target { 0 };
+
+        // Maximum number of callbacks invoked per check
+        static constexpr unsigned batch { 32 };
+
         static List     next    CPULOCAL;
         static List     curr    CPULOCAL;
         static List     done    CPULOCAL;
 
         static Epoch    epoch_l CPULOCAL;
         static Epoch    epoch_c CPULOCAL;
+        static Epoch    epoch_q CPULOCAL;
+
+        // Extended quiescent state: epoch accounted for by this CPU or credited by another CPU [63:1], idle or guest mode [0]
+        static Atomic<Epoch, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST> eqs CPULOCAL;
 
         static void set_state (State);
 
+        static void force();
+
+        static void eqs_leave();
+
         static bool complete (Epoch e, Epoch c) { return static_cast<signed long>((e & ~State::REQUESTED) - (c << 2)) > 0; }
 
         static void handle_callbacks();
@@ -93,6 +117,20 @@ class Rcu
     public:
         static void quiet();
         static void check();
+        static void expedite();
+
+        static void eqs_enter();
+
+        /*
+         * Leave the extended quiescent state (if any) before using RCU-protected data
+         *
+         * Only this CPU sets the EQS bit, so it cannot see zero while in an extended quiescent state.
+         */
+        static void eqs_exit()
+        {
+            if (EXPECT_FALSE (eqs))
+                eqs_leave();
+        }
 
         static void submit (Rcu_elem *e) { next.enqueue (e); }
 };
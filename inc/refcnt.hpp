@@ -66,6 +66,9 @@ class Refcnt
 
             return --ref;
         }
+
+        // Determine if the last reference was dropped
+        bool unreferenced() const { return !ref; }
 };
 
 template <typename T>
@@ -29,35 +29,40 @@ class Sc final : public Kobject, public Queue<Sc>::Element
     friend class Scheduler;
 
     private:
-        Refptr<Ec> const    ec;
-        uint64_t   const    budget;
+        // Accessed on every scheduling decision
         cpu_t      const    cpu;
         cos_t      const    cos;
         uint8_t    const    prio;
-        Atomic<uint64_t>    used    { 0 };
         uint64_t            left    { 0 };
         uint64_t            last    { 0 };
+        Atomic<uint64_t>    used    { 0 };
+        Refptr<Ec> const    ec;
+
+        // Accessed on budget replenishment and destruction
+        uint64_t   const    budget;
+        Refptr<Pd> const    owner;                  // PD charged for this SC
 
         static Slab_cache   cache;
 
-        Sc (Refptr<Ec>&, cpu_t, uint16_t, uint8_t, cos_t);
+        Sc (Refptr<Pd>&, Refptr<Ec>&, cpu_t, uint16_t, uint8_t, cos_t);
 
     public:
-        [[nodiscard]] static Sc *create (Status &s, Ec *ec, cpu_t cpu, uint16_t budget, uint8_t prio, cos_t cos)
+        [[nodiscard]] static Sc *create (Status &s, Pd *pd, Ec *ec, cpu_t cpu, uint16_t budget, uint8_t prio, cos_t cos)
         {
-            // Acquire reference
+            // Acquire references
+            Refptr<Pd> ref_pd { pd };
             Refptr<Ec> ref_ec { ec };
 
-            // Failed to acquire reference
-            if (EXPECT_FALSE (!ref_ec))
+            // Failed to acquire references
+            if (EXPECT_FALSE ((pd && !ref_pd) || !ref_ec))
                 s = Status::ABORTED;
 
             else {
 
-                auto const sc { new (cache) Sc { ref_ec, cpu, budget, prio, cos } };
+                auto const sc { pd ? new (pd->sc_cache) Sc { ref_pd, ref_ec, cpu, budget, prio, cos } : new (cache) Sc { ref_pd, ref_ec, cpu, budget, prio, cos } };
 
-                // If we created sc, then reference must have been consumed
-                assert (!sc || !ref_ec);
+                // If we created sc, then references must have been consumed
+                assert (!sc || (!ref_pd && !ref_ec));
 
                 if (EXPECT_TRUE (sc))
                     return sc;
@@ -70,12 +75,21 @@ class Sc final : public Kobject, public Queue<Sc>::Element
 
         void destroy()
         {
+            auto const pd { static_cast<Pd *>(owner) };
+
             this->~Sc();
 
-            operator delete (this, cache);
+            if (pd)
+                operator delete (this, pd->sc_cache);
+            else
+                operator delete (this, cache);
         }
 
+        bool busy() const;
+
         Ec *get_ec() const { return ec; }
 
+        auto get_prio() const { return prio; }
+
         uint64_t get_used() const { return used; }
 };
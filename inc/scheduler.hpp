@@ -32,13 +32,15 @@ class Scheduler final
     public:
         static constexpr auto priorities { 128 };
 
-        static void unblock (Sc *);
+        static void unblock (Sc *, bool = false);
         static void requeue();
 
         static auto get_current() { return current; }
 
         static void set_current (Sc *s) { current = s; }
 
+        static bool busy (Sc const *);
+
         [[noreturn]] static void schedule (bool = false);
 
     private:
@@ -48,9 +50,10 @@ class Scheduler final
             private:
                 Queue<Sc>   queue[priorities];
                 unsigned    prio_top { 0 };
+                Sc *        direct   { nullptr };
 
             public:
-                void enqueue (Sc *, uint64_t);
+                void enqueue (Sc *, uint64_t, bool = false);
                 auto dequeue (uint64_t);
         };
 
@@ -63,7 +66,8 @@ class Scheduler final
 
             public:
                 void enqueue (Sc *);
-                auto dequeue();
+                void requeue (Ready &, uint64_t);
+                bool busy (Sc const *);
         };
 
         static Ready        ready       CPULOCAL;
@@ -22,6 +22,7 @@
 #pragma once
 
 #include "initprio.hpp"
+#include "quota.hpp"
 #include "spinlock.hpp"
 
 class Slab_cache final
@@ -31,14 +32,69 @@ class Slab_cache final
 
         uint16_t const  bsz;                    // Buffer size
         uint16_t const  bps;                    // Buffers per Slab
+        uint16_t const  lim;                    // Empty Slab Limit
+        uint16_t        cnt     { 0 };          // Current Empty Slabs
+        uint16_t const  cst;                    // Colour Step
+        uint16_t        col     { 0 };          // Next Colour
         Slab *          curr    { nullptr };    // Current (Partial) Slab
         Slab *          head    { nullptr };    // Head of Slab List
+        Slab *          spare   { nullptr };    // Head of Empty Slab List
+        Slab_cache *    link    { nullptr };    // Next Retaining Slab_cache
         Spinlock        lock;                   // Allocator Spinlock
 
+        static Slab_cache *list;                // Head of Retaining Slab_cache List
+        static Slab_cache sized[];              // Shared Size-Class Slab Caches
+
+        bool grow();
+
     public:
         [[nodiscard]] void *alloc();
 
         void free (void *);
 
-        Slab_cache (size_t, size_t);
+        unsigned reclaim();
+
+        auto size() const { return bsz; }
+
+        static unsigned reclaim_all();
+
+        static Slab_cache &size_class (size_t);
+
+        Slab_cache (size_t, size_t, unsigned = 0);
+};
+
+/*
+ * Owner view of a shared size-class slab cache
+ *
+ * Allocations are charged to the quota of the owner, so that objects of
+ * many owners can share slabs without losing accounting.
+ */
+class Slab_account final
+{
+    private:
+        Slab_cache &    cache;                  // Shared Slab Cache
+        Quota &         quota;                  // Owner Quota
+
+    public:
+        [[nodiscard]] void *alloc()
+        {
+            if (EXPECT_FALSE (!quota.charge (cache.size())))
+                return nullptr;
+
+            auto const p { cache.alloc() };
+
+            if (EXPECT_FALSE (!p))
+                quota.uncharge (cache.size());
+
+            return p;
+        }
+
+        void free (void *p)
+        {
+            cache.free (p);
+
+            quota.uncharge (cache.size());
+        }
+
+        Slab_account (size_t s, Quota &q) : cache { Slab_cache::size_class (s) }, quota { q } {}
 };
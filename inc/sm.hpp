@@ -24,21 +24,98 @@
 
 #include "ec.hpp"
 
-class Sm final : public Kobject, private Queue<Ec>
+class Sm final : public Kobject, private Queue<Ec>, public Queue<Sm>::Element
 {
     private:
-        uint64_t        counter { 0 };
-        unsigned const  id      { 0 };
-        Spinlock        lock;
+        /*
+         * The counter and the waiter-present state are encoded in one atomic word,
+         * so that up/down operations that neither block nor wake up an EC can
+         * complete with a single CAS and without taking the spinlock.
+         *
+         * Invariants:
+         * - WAITERS is only set or cleared with the spinlock held
+         * - WAITERS is set if and only if the queue is non-empty
+         * - WAITERS is only ever set while the counter is zero
+         * - The counter is only incremented while WAITERS is clear
+         *
+         * INDIRECT permanently disables both fast paths for group semaphores and
+         * for semaphores bound to a group, whose counters are protected by the
+         * spinlock of the group.
+         */
+        static constexpr uint64_t waiters  { BIT64 (63) };
+        static constexpr uint64_t indirect { BIT64 (62) };
+
+        Atomic<uint64_t>    state   { 0 };          // waiters[63] indirect[62] counter[61:0]
+        unsigned const      id      { 0 };
+        bool const          grp     { false };
+        bool const          pri     { false };
+        Spinlock            lock;
+        Queue<Sm>           pending;                // Group: Members with a non-zero counter
+        Atomic<unsigned>    refs    { 0 };          // Member: Number of ECs whose most recent down on the group consumed it
+        Atomic<Sm *>        group   { nullptr };    // Member: Group to which this semaphore is bound
+        uintptr_t           tag     { 0 };          // Member: Tag reported by a down on the group
+        Refptr<Pd> const    owner;                  // PD charged for this semaphore
 
         static Slab_cache cache;
 
-        Sm (uint64_t, unsigned);
+        Sm (Refptr<Pd> &, uint64_t, unsigned, bool, bool);
+
+        ~Sm()
+        {
+            if (group)
+                group->ref_dec();
+        }
+
+        bool signal (Sm *, bool);
+
+        /*
+         * Enqueue a blocked EC according to the wake policy of this semaphore
+         *
+         * FIFO: ECs are woken up in the order in which they blocked
+         * PRIO: ECs are woken up in the order of the priority of their SC
+         *
+         * @param ec    EC to enqueue
+         */
+        ALWAYS_INLINE NONNULL
+        inline void enqueue_waiter (Ec *ec)
+        {
+            if (!pri)
+                enqueue_tail (ec);
+            else {
+                ec->set_prio();
+                enqueue_prio (ec, [] (Ec const *e) { return e->get_prio(); });
+            }
+        }
+
+        NOINLINE
+        bool dn_slow (Ec *, bool, uint64_t);
+
+        NOINLINE
+        bool up_slow (bool);
 
     public:
-        [[nodiscard]] static Sm *create (Status &s, uint64_t c, unsigned i)
+        static constexpr uint64_t counter_max { indirect - 1 };
+
+        [[nodiscard]] static Sm *create (Status &s, Pd *pd, uint64_t c, unsigned i, bool g = false, bool p = false)
         {
-            auto const sm { new (cache) Sm (c, i) };
+            if (EXPECT_FALSE (c > counter_max || (g && c))) {
+                s = Status::BAD_PAR;
+                return nullptr;
+            }
+
+            // Acquire reference
+            Refptr<Pd> ref_pd { pd };
+
+            // Failed to acquire reference
+            if (EXPECT_FALSE (pd && !ref_pd)) {
+                s = Status::ABORTED;
+                return nullptr;
+            }
+
+            auto const sm { pd ? new (pd->sm_cache) Sm (ref_pd, c, i, g, p) : new (cache) Sm (ref_pd, c, i, g, p) };
+
+            // If we created sm, then reference must have been consumed
+            assert (!sm || !ref_pd);
 
             if (EXPECT_FALSE (!sm))
                 s = Status::MEM_OBJ;
@@ -48,62 +125,105 @@ class Sm final : public Kobject, private Queue<Ec>
 
         void destroy()
         {
+            auto const pd { static_cast<Pd *>(owner) };
+
             this->~Sm();
 
-            operator delete (this, cache);
+            if (pd)
+                operator delete (this, pd->sm_cache);
+            else
+                operator delete (this, cache);
         }
 
-        auto get_id() const { return id; }
-
-        void dn (Ec *const self, bool zero, uint64_t t)
-        {
-            {   Lock_guard <Spinlock> guard { lock };
+        /*
+         * Determine if the semaphore is still in use without holding a reference
+         *
+         * @return      True if ECs are blocked on it or if it is pending in its group or not yet retired by an EC
+         */
+        bool busy() const { return !empty() || queued() || refs; }
 
-                if (counter) {
-                    counter = zero ? 0 : counter - 1;
-                    return;
-                }
+        auto get_id() const { return id; }
 
-                // The EC can no longer be activated
-                self->block();
+        bool is_group() const { return grp; }
+        bool is_member() const { return group; }
 
-                enqueue_tail (self);
-            }
+        Status bind (Sm *, uintptr_t);
 
-            // At this point remote cores can unblock the EC
+        Sm *dn_group (Ec *, bool, uint64_t);
 
-            if (self->block_sc()) {
+        /*
+         * Retire the member that was consumed by the most recent down of an EC on a group
+         *
+         * The member remains busy until it is released.
+         *
+         * @param ec    EC that performed the down
+         * @return      Member semaphore (or nullptr if there was none)
+         */
+        NONNULL
+        static Sm *retire (Ec *ec)
+        {
+            auto const sm { ec->consumed };
 
-                if (t)
-                    self->set_timeout (t, this);
+            ec->consumed = nullptr;
 
-                Scheduler::schedule (true);
-            }
+            return sm;
         }
 
-        bool up()
+        NONNULL
+        static void unretire (Ec *ec, Sm *sm) { ec->consumed = sm; }
+
+        void release() { refs--; }
+
+        auto get_tag() const { return tag; }
+
+        /*
+         * Down operation
+         *
+         * Fast path: Consume the counter with a single CAS if it is non-zero
+         * Slow path: Block the EC if the counter is zero
+         *
+         * The semaphore can be bound to a group after the caller checked that it
+         * is not a member, so both paths recheck INDIRECT.
+         *
+         * @param self  Calling EC
+         * @param zero  True to consume the entire counter, false to decrement it
+         * @param t     Absolute timeout (or 0 for no timeout)
+         * @return      True if successful, false if the semaphore is bound to a group
+         */
+        [[nodiscard]]
+        bool dn (Ec *const self, bool zero, uint64_t t)
         {
-            Ec *ec;
+            assert (!is_group());
 
-            {   Lock_guard <Spinlock> guard { lock };
+            // A non-zero counter implies that there are no waiters
+            for (uint64_t o { state }; (o & counter_max) && !(o & indirect); )
+                if (EXPECT_TRUE (state.compare_exchange_n (o, zero ? 0 : o - 1)))
+                    return true;
 
-                if (!(ec = dequeue_head())) {
+            return dn_slow (self, zero, t);
+        }
 
-                    if (counter == ~0ULL)
-                        return false;
+        /*
+         * Up operation
+         *
+         * Fast path: Increment the counter with a single CAS if there are no waiters
+         * Slow path: Wake up the first waiter
+         *
+         * @param d     True to switch directly to the woken EC if its priority permits
+         * @return      True if successful, false if the counter would overflow
+         */
+        bool up (bool d = false)
+        {
+            for (uint64_t o { state }; !(o & (waiters | indirect)); ) {
 
-                    counter++;
+                if (EXPECT_FALSE (o == counter_max))
+                    return false;
 
+                if (EXPECT_TRUE (state.compare_exchange_n (o, o + 1)))
                     return true;
-                }
-
-                // The EC can now be activated again
-                ec->unblock (Ec::sys_finish<Status::SUCCESS, true>, false);
             }
 
-            ec->unblock_sc();
-
-            return true;
+            return up_slow (d);
         }
 
         NONNULL
@@ -116,6 +236,9 @@ class Sm final : public Kobject, private Queue<Ec>
 
                 dequeue (ec);
 
+                if (empty())
+                    state &= ~waiters;
+
                 // The EC can now be activated again
                 ec->unblock (Ec::sys_finish<Status::TIMEOUT>, true);
             }
@@ -35,4 +35,6 @@ class Space : public Kobject
 
     public:
         Pd *get_pd() const { return pd; }
+
+        Quota *get_quota() const { return pd ? &pd->get_quota() : nullptr; }
 };
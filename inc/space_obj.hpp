@@ -45,7 +45,21 @@ class Space_obj final : public Space
 
         ~Space_obj();
 
-        Atomic<Capability> *walk (unsigned long, bool);
+        Atomic<Capability> *walk (unsigned long, bool, Atomic<Captable *> *&, unsigned long * = nullptr);
+        Atomic<Capability> *find (unsigned long, unsigned long * = nullptr) const;
+
+        /*
+         * Number of selectors from a selector to the end of its subtree at a level
+         *
+         * @param sel   Selector
+         * @param l     Level of the subtree (1 = leaf Captable)
+         * @return      Number of selectors
+         */
+        static auto span (unsigned long sel, unsigned l) { return BITN (l * bpl) - sel % BITN (l * bpl); }
+
+        void adjust (Atomic<Captable *> *, int);
+
+        static int replace (Atomic<Capability> *, Capability);
 
     public:
         static Space_obj nova;
@@ -68,7 +82,7 @@ class Space_obj final : public Space
             NOVA_CPU = 0,
         };
 
-        [[nodiscard]] static Space_obj *create (Status &s, Slab_cache &cache, Pd *pd)
+        [[nodiscard]] static Space_obj *create (Status &s, Slab_account &cache, Pd *pd)
         {
             // Acquire reference
             Refptr<Pd> ref_pd { pd };
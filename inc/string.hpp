@@ -21,31 +21,9 @@
 #pragma once
 
 #include "compiler.hpp"
+#include "string_arch.hpp"
 #include "types.hpp"
 
-extern "C" NONNULL
-inline void *memcpy (void *d, void const *s, size_t n)
-{
-    auto dst { static_cast<char *>(d) };
-    auto src { static_cast<char const *>(s) };
-
-    while (n--)
-        *dst++ = *src++;
-
-    return d;
-}
-
-extern "C" NONNULL
-inline void *memset (void *d, int c, size_t n)
-{
-    auto dst { static_cast<char *>(d) };
-
-    while (n--)
-        *dst++ = static_cast<char>(c);
-
-    return d;
-}
-
 extern "C" NONNULL
 inline int strcmp (char const *s1, char const *s2)
 {
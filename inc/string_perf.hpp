@@ -0,0 +1,39 @@
+/*
+ * String Function Performance
+ *
+ * Copyright (C) 2019-2024 Udo Steinberg, BedRock Systems, Inc.
+ *
+ * This file is part of the NOVA microhypervisor.
+ *
+ * NOVA is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NOVA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License version 2 for more details.
+ */
+
+#pragma once
+
+#include "types.hpp"
+
+/*
+ * Boot-time measurement of the string primitive variants
+ *
+ * Each variant processes the same buffers the same number of times, so that
+ * the reported times are comparable with each other.
+ */
+class String_perf final
+{
+    private:
+        static constexpr unsigned ord  { 4 };   // Buffer Order
+        static constexpr unsigned reps { 32 };  // Buffer Passes per Variant
+
+        template <typename F>
+        static uint64_t measure (F const &);
+
+    public:
+        static void report();
+};
@@ -111,6 +111,8 @@ struct Sys_create_sm final : private Sys_abi
 {
     inline Sys_create_sm (Sys_regs &r) : Sys_abi (r) {}
 
+    inline auto flg() const { return flags(); }
+
     inline unsigned long sel() const { return p0() >> 8; }
 
     inline unsigned long pd() const { return p1(); }
@@ -174,9 +176,17 @@ struct Sys_ctrl_sm final : private Sys_abi
 
     inline bool zc() const { return flags() & BIT (1); }
 
+    inline bool bind() const { return flags() & BIT (2); }
+
     inline unsigned long sm() const { return p0() >> 8; }
 
     inline uint64_t time_ticks() const { return p1(); }
+
+    inline unsigned long grp() const { return p1(); }
+
+    inline uintptr_t tag() const { return p2(); }
+
+    inline void set_tag (uintptr_t val) { p1() = val; }
 };
 
 struct Sys_ctrl_hw final : private Sys_abi
@@ -186,6 +196,16 @@ struct Sys_ctrl_hw final : private Sys_abi
     inline auto op() const { return flags(); }
 
     inline auto desc() const { return p0() >> 8; }
+
+    inline size_t limit() const { return p1(); }
+
+    inline uint64_t phys() const { return p1(); }
+
+    inline size_t size() const { return p2(); }
+
+    inline void set_used (size_t val) { p1() = val; }
+
+    inline void set_limit (size_t val) { p2() = val; }
 };
 
 struct Sys_assign_int final : private Sys_abi
@@ -200,6 +220,12 @@ struct Sys_assign_int final : private Sys_abi
 
     inline auto dev() const { return static_cast<uint16_t> (p2()); }
 
+    inline uint64_t itv() const { return p3(); }
+
+    inline uint32_t bat() const { return static_cast<uint32_t> (p4()); }
+
+    inline bool dsw() const { return p4() & BIT64 (32); }
+
     inline void set_msi_addr (uint32_t val) { p1() = val; }
 
     inline void set_msi_data (uint16_t val) { p2() = val; }
@@ -0,0 +1,61 @@
+/*
+ * Interrupt Moderation Timeout
+ *
+ * Copyright (C) 2019-2024 Udo Steinberg, BedRock Systems, Inc.
+ *
+ * This file is part of the NOVA microhypervisor.
+ *
+ * NOVA is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NOVA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License version 2 for more details.
+ */
+
+#pragma once
+
+#include "atomic.hpp"
+#include "timeout.hpp"
+
+class Interrupt;
+
+/*
+ * Interrupt moderation coalesces interrupts into semaphore wakeups
+ *
+ * ITV: The semaphore is signaled at most once per interval (in ticks)
+ * BAT: The semaphore is signaled once the batch count has accumulated
+ *
+ * A batch count requires an interval, which delivers an incomplete batch.
+ * Edge-triggered interrupts are reenabled while they accumulate, whereas
+ * level-triggered interrupts remain masked and are only delayed.
+ *
+ * Each signal delivers all interrupts accumulated since the previous one.
+ * The timeout only ever lives on the timeout list of the CPU that handles
+ * the interrupt. If the interrupt is rerouted while the timeout is armed,
+ * the old CPU delivers the accumulated interrupts when the timeout fires.
+ */
+class Timeout_interrupt final : public Timeout
+{
+    private:
+        Interrupt * const   irq     { nullptr };
+        Atomic<uint64_t>    itv     { 0 };          // Minimum inter-wakeup interval
+        Atomic<uint32_t>    bat     { 0 };          // Batch count
+        Atomic<uint32_t>    cnt     { 0 };          // Accumulated interrupts
+        Atomic<bool>        armed   { false };      // Timeout enqueued
+        Atomic<bool>        dsw     { false };      // Direct switch to the woken EC
+        Atomic<uint64_t>    last    { 0 };          // Time of the most recent wakeup
+
+        void flush (uint64_t);
+
+        void trigger() override;
+
+    public:
+        Timeout_interrupt (Interrupt *i) : irq (i) {}
+
+        void configure (uint64_t, uint32_t, bool);
+
+        void signal();
+};
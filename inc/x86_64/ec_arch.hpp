@@ -31,10 +31,16 @@
 class Ec_arch final : private Ec
 {
     friend class Ec;
+    friend class Interrupt;
 
     private:
         static constexpr auto needs_pio { true };
 
+        bool vmcs_inactive { false };           // VMX: The VMCS of this vCPU was cleared on its CPU
+
+        static Queue<Ec>    vmcs_queue  CPULOCAL;   // VMX: vCPUs whose VMCS must be cleared on this CPU
+        static Spinlock     vmcs_lock   CPULOCAL;
+
         // Constructor: Kernel Thread
         Ec_arch (Refptr<Space_obj> &, Refptr<Space_hst> &, Refptr<Space_pio> &, cpu_t, cont_t);
 
@@ -79,6 +85,12 @@ class Ec_arch final : private Ec
 
         [[noreturn]] static void set_vmm_regs_vmx (Ec *);
 
+        bool vcpu_busy();
+
+        void vcpu_fini();
+
+        static void clear_vmcs();
+
         ALWAYS_INLINE
         inline void state_load (Ec *const self, Mtd_arch mtd)
         {
@@ -220,7 +220,7 @@ class Fpu final
          * @return      Pointer to XSAVE area
          */
         [[nodiscard]] ALWAYS_INLINE
-        static inline void *operator new (size_t, Slab_cache &cache) noexcept
+        static inline void *operator new (size_t, Slab_account &cache) noexcept
         {
             return cache.alloc();
         }
@@ -232,7 +232,7 @@ class Fpu final
          * @param cache FPU slab cache
          */
         ALWAYS_INLINE
-        static inline void operator delete (void *ptr, Slab_cache &cache)
+        static inline void operator delete (void *ptr, Slab_account &cache)
         {
             if (EXPECT_TRUE (ptr))
                 cache.free (ptr);
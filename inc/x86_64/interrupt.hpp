@@ -23,9 +23,11 @@
 
 #include "atomic.hpp"
 #include "macros.hpp"
+#include "timeout_interrupt.hpp"
 #include "types.hpp"
 #include "vectors.hpp"
 
+class Cpuset;
 class Ioapic;
 class Sm;
 
@@ -66,9 +68,10 @@ class Interrupt final
             RKE,
         };
 
-        Sm *            sm      { nullptr };
-        Ioapic *        ioapic  { nullptr };
-        Atomic<Config>  config  { Config (0, 0, BIT (0)) };
+        Sm *                sm      { nullptr };
+        Ioapic *            ioapic  { nullptr };
+        Atomic<Config>      config  { Config (0, 0, BIT (0)) };
+        Timeout_interrupt   timeout { this };
 
         static inline unsigned pin { 0 };
 
@@ -95,4 +98,5 @@ class Interrupt final
 
         static void send_cpu (Request, cpu_t);
         static void send_exc (Request);
+        static void send_set (Request, Cpuset const &);
 };
@@ -23,6 +23,7 @@
 #pragma once
 
 #include "cpu.hpp"
+#include "cpuset.hpp"
 
 class Lapic final
 {
@@ -158,6 +159,47 @@ class Lapic final
             set_icr ((x2apic ? static_cast<uint64_t>(Cpu::remote_topology (c)) << 32 : static_cast<uint64_t>(id[c]) << 56) | BIT (14) | std::to_underlying (d) | v);
         }
 
+        /*
+         * Send IPI to a set of CPUs
+         *
+         * In x2APIC mode, the IPI is multicast to all CPUs of the set that share a
+         * logical cluster, whose logical ID is derived from the x2APIC ID.
+         *
+         * @param v     Vector
+         * @param s     CPU set
+         * @param d     Delivery mode
+         */
+        static void send_set (unsigned v, Cpuset const &s, Delivery d = Delivery::DLV_FIXED)
+        {
+            Cpuset done;
+
+            for (cpu_t c { 0 }; c < Cpu::count; c++) {
+
+                if (!s.tst (c) || done.tas (c))
+                    continue;
+
+                if (EXPECT_FALSE (!x2apic)) {
+                    send_cpu (v, c, d);
+                    continue;
+                }
+
+                auto const cls { Cpu::remote_topology (c) >> 4 };
+
+                uint32_t ldr { 0 };
+
+                // Collect all CPUs of the set in the same logical cluster
+                for (cpu_t i { c }; i < Cpu::count; i++) {
+
+                    auto const t { Cpu::remote_topology (i) };
+
+                    if (s.tst (i) && t >> 4 == cls && (i == c || !done.tas (i)))
+                        ldr |= BIT (t & BIT_RANGE (3, 0));
+                }
+
+                set_icr (static_cast<uint64_t>(cls << 16 | ldr) << 32 | BIT (14) | BIT (11) | std::to_underlying (d) | v);
+            }
+        }
+
         /*
          * Send IPI to all CPUs (excluding self)
          *
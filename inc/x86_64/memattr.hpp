@@ -105,6 +105,8 @@ class Memattr final
 
         static auto ept_to_ca (unsigned e) { return Cache (BIT_RANGE (2, 0) & rev >> 8 * e); }
 
+        bool operator== (Memattr const &x) const { return val == x.val; }
+
         bool valid() const { return keyid() <= kimax && cache_s1() < std::to_underlying (Cache::UNUSED); }
 };
 
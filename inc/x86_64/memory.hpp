@@ -57,3 +57,4 @@
 #define LINK_ADDR       0xffffffff80000000      // 511 510 000 000  512M
 
 #define OFFSET          (LINK_ADDR - LOAD_ADDR)
+#define LINK_END        MMAP_GLB_PCIS           // End of linear kernel memory window
@@ -36,4 +36,10 @@ class Pte : public Ptab<T, I, O>::Entry
         auto type (unsigned l) const { return E::val ? l && !(E::val & T::ATTR_S) ? E::Type::PTAB : E::Type::LEAF : E::Type::HOLE; }
 
         static inline void publish() {}
+
+        // A leaf page table can be replaced with an equivalent large page without break-before-make
+        static constexpr bool promotable { true };
+
+        // Software-available bit in a PTE that refers to a page table, set while the page table is being promoted
+        static constexpr typename E::OAddr lock { BIT64 (62) };
 };
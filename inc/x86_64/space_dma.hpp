@@ -28,8 +28,9 @@
 class Space_dma final : public Space_mem<Space_dma>
 {
     private:
-        Sdid const  sdid;
-        Dptp        dptp;
+        Sdid const      sdid;
+        Dptp            dptp;
+        Atomic<bool>    used    { false };      // A device was assigned to this space
 
         Space_dma() : Space_mem { Kobject::Subtype::DMA } {}
 
@@ -43,7 +44,7 @@ class Space_dma final : public Space_mem<Space_dma>
 
         [[nodiscard]] inline auto get_ptab (unsigned l) { return dptp.root_init (l); }
 
-        [[nodiscard]] static Space_dma *create (Status &s, Slab_cache &cache, Pd *pd)
+        [[nodiscard]] static Space_dma *create (Status &s, Slab_account &cache, Pd *pd)
         {
             // Acquire reference
             Refptr<Pd> ref_pd { pd };
@@ -61,7 +62,7 @@ class Space_dma final : public Space_mem<Space_dma>
 
                 if (EXPECT_TRUE (dma)) {
 
-                    if (EXPECT_TRUE (dma->dptp.root_init()))
+                    if (EXPECT_TRUE (dma->dptp.root_init (dma->get_quota())))
                         return dma;
 
                     operator delete (dma, cache);
@@ -77,16 +78,35 @@ class Space_dma final : public Space_mem<Space_dma>
         {
             auto &cache { get_pd()->dma_cache };
 
+            dptp.root_fini (get_quota());
+
             this->~Space_dma();
 
             operator delete (this, cache);
         }
 
-        auto update (uint64_t v, uint64_t p, unsigned o, Paging::Permissions pm, Memattr ma) { return dptp.update (v, p, o, pm, ma); }
+        // The SMMU may cache non-present entries, so DMA updates always require invalidation
+        auto update (uint64_t v, uint64_t p, unsigned o, Paging::Permissions pm, Memattr ma, bool *inv = nullptr)
+        {
+            if (inv)
+                *inv = true;
+
+            return dptp.update (v, p, o, pm, ma, get_quota());
+        }
 
         void sync() { Smmu::invalidate_tlb_all (sdid); }
 
         auto get_sdid() const { return sdid; }
 
+        /*
+         * Mark the space as used by a device before the device is assigned to it
+         *
+         * A used space is never destroyed, because there is no record of the devices
+         * that may still access its page tables.
+         */
+        void set_used() { used = true; }
+
+        bool is_used() const { return used; }
+
         static void user_access (uint64_t addr, size_t size, bool a) { Space_mem::user_access (nova, addr, size, a, Memattr::ram()); }
 };
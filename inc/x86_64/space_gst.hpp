@@ -31,7 +31,8 @@ class Space_gst final : public Space_mem<Space_gst>
     private:
         Eptp    eptp;
 
-        Space_gst (Refptr<Pd> &p) : Space_mem { Kobject::Subtype::GST, p } {}
+        // Flush stale translations that a previous space with the same EPT root left behind on first use
+        Space_gst (Refptr<Pd> &p) : Space_mem { Kobject::Subtype::GST, p } { gtlb.set(); }
 
     public:
         Cpuset  gtlb;
@@ -39,7 +40,7 @@ class Space_gst final : public Space_mem<Space_gst>
         static inline auto selectors() { return BIT64 (Ept::ibits - PAGE_BITS); }
         static inline auto max_order() { return Ept::lev_ord(); }
 
-        [[nodiscard]] static Space_gst *create (Status &s, Slab_cache &cache, Pd *pd)
+        [[nodiscard]] static Space_gst *create (Status &s, Slab_account &cache, Pd *pd)
         {
             // Acquire reference
             Refptr<Pd> ref_pd { pd };
@@ -57,7 +58,7 @@ class Space_gst final : public Space_mem<Space_gst>
 
                 if (EXPECT_TRUE (gst)) {
 
-                    if (EXPECT_TRUE (gst->eptp.root_init()))
+                    if (EXPECT_TRUE (gst->eptp.root_init (gst->get_quota())))
                         return gst;
 
                     operator delete (gst, cache);
@@ -73,6 +74,8 @@ class Space_gst final : public Space_mem<Space_gst>
         {
             auto &cache { get_pd()->gst_cache };
 
+            eptp.root_fini (get_quota());
+
             this->~Space_gst();
 
             operator delete (this, cache);
@@ -80,7 +83,7 @@ class Space_gst final : public Space_mem<Space_gst>
 
         auto lookup (uint64_t v, uint64_t &p, unsigned &o, Memattr &ma) const { return eptp.lookup (v, p, o, ma); }
 
-        auto update (uint64_t v, uint64_t p, unsigned o, Paging::Permissions pm, Memattr ma) { return eptp.update (v, p, o, pm, ma); }
+        auto update (uint64_t v, uint64_t p, unsigned o, Paging::Permissions pm, Memattr ma, bool *inv = nullptr) { return eptp.update (v, p, o, pm, ma, get_quota(), inv); }
 
         void sync() { gtlb.set(); Tlb::shootdown (this); }
 
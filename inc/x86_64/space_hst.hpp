@@ -33,7 +33,8 @@ class Space_hst final : public Space_mem<Space_hst>
     private:
         Space_hst();
 
-        Space_hst (Refptr<Pd> &p) : Space_mem { Kobject::Subtype::HST, p } {}
+        // Flush stale translations that a previous space with the same PCID left behind on first use
+        Space_hst (Refptr<Pd> &p) : Space_mem { Kobject::Subtype::HST, p } { htlb.set(); }
 
     public:
         Pcid const  pcid;
@@ -51,7 +52,7 @@ class Space_hst final : public Space_mem<Space_hst>
 
         [[nodiscard]] inline auto get_ptab (unsigned cpu) { return loc[cpu].root_init(); }
 
-        [[nodiscard]] static Space_hst *create (Status &s, Slab_cache &cache, Pd *pd)
+        [[nodiscard]] static Space_hst *create (Status &s, Slab_account &cache, Pd *pd)
         {
             // Acquire reference
             Refptr<Pd> ref_pd { pd };
@@ -69,7 +70,7 @@ class Space_hst final : public Space_mem<Space_hst>
 
                 if (EXPECT_TRUE (hst)) {
 
-                    if (EXPECT_TRUE (hst->hptp.root_init()))
+                    if (EXPECT_TRUE (hst->hptp.root_init (hst->get_quota())))
                         return hst;
 
                     operator delete (hst, cache);
@@ -85,14 +86,31 @@ class Space_hst final : public Space_mem<Space_hst>
         {
             auto &cache { get_pd()->hst_cache };
 
+            // The per-CPU roots share their subtrees with hptp and the kernel and are not deallocated
+            hptp.root_fini (get_quota());
+
             this->~Space_hst();
 
             operator delete (this, cache);
         }
 
+        /*
+         * Determine if the space is still current on any core without holding a reference
+         *
+         * @return      True if the space is current on any core, false otherwise
+         */
+        bool busy() const
+        {
+            for (cpu_t c { 0 }; c < Cpu::count; c++)
+                if (*Kmem::loc_to_glob (c, &current) == this)
+                    return true;
+
+            return false;
+        }
+
         auto lookup (uint64_t v, uint64_t &p, unsigned &o, Memattr &ma) const { return hptp.lookup (v, p, o, ma); }
 
-        auto update (uint64_t v, uint64_t p, unsigned o, Paging::Permissions pm, Memattr ma) { return hptp.update (v, p, o, pm, ma); }
+        auto update (uint64_t v, uint64_t p, unsigned o, Paging::Permissions pm, Memattr ma, bool *inv = nullptr) { return hptp.update (v, p, o, pm, ma, get_quota(), inv); }
 
         void sync() { htlb.set(); Tlb::shootdown (this); }
 
@@ -89,7 +89,7 @@ class Space_msr final : public Space
 
         [[nodiscard]] auto get_phys() const { return Kmem::ptr_to_phys (bmp); }
 
-        [[nodiscard]] static Space_msr *create (Status &s, Slab_cache &cache, Pd *pd)
+        [[nodiscard]] static Space_msr *create (Status &s, Slab_account &cache, Pd *pd)
         {
             // Acquire reference
             Refptr<Pd> ref_pd { pd };
@@ -57,7 +57,7 @@ class Space_pio final : public Space
 
         [[nodiscard]] auto get_phys() const { return Kmem::ptr_to_phys (bmp); }
 
-        [[nodiscard]] static Space_pio *create (Status &s, Slab_cache &cache, Pd *pd, bool a)
+        [[nodiscard]] static Space_pio *create (Status &s, Slab_account &cache, Pd *pd, bool a)
         {
             // Acquire references
             Refptr<Pd> ref_pd { pd };
@@ -0,0 +1,69 @@
+/*
+ * String Functions: Architecture-Specific Part (x86)
+ *
+ * Copyright (C) 2019-2024 Udo Steinberg, BedRock Systems, Inc.
+ *
+ * This file is part of the NOVA microhypervisor.
+ *
+ * NOVA is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NOVA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License version 2 for more details.
+ */
+
+#pragma once
+
+#include "compiler.hpp"
+#include "patch.hpp"
+#include "types.hpp"
+
+/*
+ * The default variants use "rep movsb" and "rep stosb", which are fast on CPUs
+ * with ERMS/FSRM. On other CPUs they are patched to move quadwords first.
+ */
+#define ASM_MEMCPY_0 rep movsb
+#define ASM_MEMCPY_1 mov %%rcx, %%rdx; shr $3, %%rcx; rep movsq; mov %%edx, %%ecx; and $7, %%ecx; rep movsb
+#define ASM_MEMSET_0 rep stosb
+#define ASM_MEMSET_1 mov %%rcx, %%rdx; shr $3, %%rcx; rep stosq; mov %%edx, %%ecx; and $7, %%ecx; rep stosb
+
+extern "C" NONNULL ALWAYS_INLINE
+inline void *memcpy (void *d, void const *s, size_t n)
+{
+    void *dst { d };
+
+    asm volatile (EXPAND (PATCH (ASM_MEMCPY_0, ASM_MEMCPY_1, PATCH_ERMS)) : "+D" (dst), "+S" (s), "+c" (n) : : "rdx", "memory");
+
+    return d;
+}
+
+extern "C" NONNULL ALWAYS_INLINE
+inline void *memset (void *d, int c, size_t n)
+{
+    void *dst { d };
+
+    asm volatile (EXPAND (PATCH (ASM_MEMSET_0, ASM_MEMSET_1, PATCH_ERMS)) : "+D" (dst), "+c" (n) : "a" (static_cast<uint8_t>(c) * 0x0101010101010101ULL) : "rdx", "memory");
+
+    return d;
+}
+
+/*
+ * Zero whole pages with non-temporal stores, which do not pollute the caches
+ *
+ * @param d     Page-aligned pointer to the region
+ * @param n     Size of the region (multiple of the page size)
+ */
+extern "C" NONNULL
+inline void *memzero (void *d, size_t n)
+{
+    for (auto dst { static_cast<char *>(d) }; n; n -= 32, dst += 32)
+        asm volatile ("movnti %1, 0(%0); movnti %1, 8(%0); movnti %1, 16(%0); movnti %1, 24(%0)" : : "r" (dst), "r" (0UL) : "memory");
+
+    // Order the weakly-ordered non-temporal stores before subsequent stores
+    asm volatile ("sfence" : : : "memory");
+
+    return d;
+}
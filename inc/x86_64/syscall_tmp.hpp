@@ -20,3 +20,5 @@
 template void Ec::send_msg<Ec_arch::ret_user_exception> (Ec *);
 template void Ec::send_msg<Ec_arch::ret_user_vmexit_vmx> (Ec *);
 template void Ec::send_msg<Ec_arch::ret_user_vmexit_svm> (Ec *);
+
+template void Ec::sys_finish<Status::SUCCESS, true> (Ec *);
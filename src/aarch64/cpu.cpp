@@ -334,6 +334,11 @@ bool Cpu::allocate (cpu_t cpu, uint64_t m, uint64_t r)
         // Add to CPU array
         Hptp::master_map (MMAP_GLB_CPUS + cpu * PAGE_SIZE (0), Kmem::ptr_to_phys (c), 0, Paging::Permissions (Paging::G | Paging::W | Paging::R), Memattr::ram());
 
+        // Report the page sizes that back the kernel mappings
+        unsigned n[Hpt::lev()] { 0 };
+        hptp.census (MMAP_CPU_GICR, LINK_END, n);
+        trace (TRACE_MEMORY, "KMAP: CPU:%u 4K:%u 2M:%u 1G:%u", cpu, n[0], n[1], n[2]);
+
         // Prefill addresses
         *Kmem::loc_to_glob (cpu, &mpidr) = m;
         *Kmem::loc_to_glob (cpu, &gicr)  = r;
@@ -80,7 +80,7 @@ Ec *Ec::create_gst (Status &s, Pd *pd, bool t, bool fpu, cpu_t cpu, unsigned lon
     auto const v { new Vmcb };
     Ec *ec;
 
-    if (EXPECT_TRUE ((!fpu || f) && v && (ec = new (cache) Ec_arch { t, f, ref_obj, ref_hst, v, cpu, evt, sp }))) {
+    if (EXPECT_TRUE ((!fpu || f) && v && (ec = new (pd->ec_cache) Ec_arch { t, f, ref_obj, ref_hst, v, cpu, evt, sp }))) {
         assert (!ref_obj && !ref_hst);
         return ec;
     }
@@ -93,6 +93,26 @@ Ec *Ec::create_gst (Status &s, Pd *pd, bool t, bool fpu, cpu_t cpu, unsigned lon
     return nullptr;
 }
 
+/*
+ * Determine if the VMCB of this unused vCPU is still loaded on its CPU
+ *
+ * A VMCB at the same address would otherwise skip loading its state.
+ *
+ * @return      True if the VMCB is loaded, false otherwise
+ */
+bool Ec_arch::vcpu_busy() const
+{
+    return *Kmem::loc_to_glob (cpu, &Vmcb::current) == regs.vmcb;
+}
+
+/*
+ * Free the VMCB of this vCPU
+ */
+void Ec_arch::vcpu_fini()
+{
+    delete regs.vmcb;
+}
+
 void Ec::adjust_offset_ticks (uint64_t t)
 {
     if (subtype == Kobject::Subtype::EC_VCPU_OFFS)
@@ -194,6 +214,8 @@ void Ec_arch::ret_user_vmexit (Ec *const self)
 
     self->regs.get_gst()->make_current();
 
+    Rcu::eqs_enter();
+
     asm volatile ("mov sp, %0;" EXPAND (LOAD_STATE ERET) : : "r" (&self->exc_regs()), "m" (self->exc_regs()));
 
     UNREACHED;
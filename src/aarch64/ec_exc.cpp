@@ -21,6 +21,7 @@
 #include "fpu.hpp"
 #include "interrupt.hpp"
 #include "pd.hpp"
+#include "rcu.hpp"
 #include "smc.hpp"
 #include "stdio.hpp"
 #include "vmcb.hpp"
@@ -52,6 +53,8 @@ void Ec_arch::handle_exc_user (Exc_regs *r)
 
     Ec *const self { current };
 
+    Rcu::eqs_exit();
+
     bool resolved { false };
 
     // SVC #0 from AArch64 state
@@ -84,6 +87,8 @@ void Ec_arch::handle_irq_user()
 {
     Ec *const self { current };
 
+    Rcu::eqs_exit();
+
     Event::Selector evt = Interrupt::handler (self->is_vcpu());
 
     if (!self->is_vcpu())
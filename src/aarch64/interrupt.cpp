@@ -22,6 +22,7 @@
 #include "gicd.hpp"
 #include "gicr.hpp"
 #include "interrupt.hpp"
+#include "rcu.hpp"
 #include "sm.hpp"
 #include "smmu.hpp"
 #include "space_obj.hpp"
@@ -40,6 +41,8 @@ void Interrupt::rke_handler()
 {
     if (Acpi::get_transition().state())
         Cpu::hazard |= Hazard::SLEEP;
+
+    Rcu::check();
 }
 
 Event::Selector Interrupt::handle_sgi (uint32_t val, bool)
@@ -92,7 +95,7 @@ Event::Selector Interrupt::handle_spi (uint32_t val, bool)
     Gicc::eoi (val);
 
     if (EXPECT_TRUE (int_table[spi].sm))
-        int_table[spi].sm->up();
+        int_table[spi].timeout.signal();
 
     else {
 
@@ -26,7 +26,13 @@
 #include "kmem.hpp"
 #include "lock_guard.hpp"
 #include "multiboot.hpp"
+#include "ptab_hpt.hpp"
+#include "rcu.hpp"
+#include "space_dma.hpp"
+#include "space_hst.hpp"
+#include "stdio.hpp"
 #include "string.hpp"
+#include "timer.hpp"
 
 Buddy::Waitlist Buddy::waitlist;
 
@@ -35,64 +41,275 @@ Buddy::Waitlist Buddy::waitlist;
  */
 void Buddy::init()
 {
+    auto const t { Timer::time() };
+
     auto const virt { reinterpret_cast<uintptr_t>(&KMEM_HVAS) };
     auto const size { reinterpret_cast<uintptr_t>(Kmem::phys_to_ptr (Multiboot::ea)) - virt };
 
     mem_base = align_dn (virt, PAGE_SIZE (1));
-    min_idx  = page_to_index (virt);
-    max_idx  = page_to_index (virt + (size / (PAGE_SIZE (0) + sizeof (Block))) * PAGE_SIZE (0));
-    blk_base = reinterpret_cast<Block *>(virt + size) - max_idx;
+
+    auto &p { pool[0] };
+
+    p.min_idx  = page_to_index (virt);
+    p.blk_base = reinterpret_cast<Block *>(virt + size) - (p.max_idx = p.min_idx + (size - p.min_idx * sizeof (Block)) / (PAGE_SIZE (0) + sizeof (Block)));
 
     // Free all pages in the pool
-    for (auto i { reinterpret_cast<uintptr_t>(&KMEM_HVAF) }; i < index_to_page (max_idx); i += PAGE_SIZE (0))
-        free (reinterpret_cast<void *>(i));
+    insert (page_to_index (reinterpret_cast<uintptr_t>(&KMEM_HVAF)), p.max_idx);
+
+    ticks = Timer::time() - t;
 }
 
 /*
- * Allocate physically and virtually contiguous memory region
+ * Insert free pages into the freelists as maximal aligned blocks
  *
- * @param ord       Block order (2^ord pages)
- * @param fill      Fill pattern for the block
- * @return          Pointer to virtual memory region or nullptr if unsuccessful
+ * @param s         First page index
+ * @param e         End page index (exclusive)
  */
-void *Buddy::alloc (order_t ord, Fill fill)
+void Buddy::insert (index_t s, index_t e)
 {
     Lock_guard <Spinlock> guard { lock };
 
-    // Iterate over all freelists, starting with the requested order
-    for (auto o { ord }; o < orders; o++) {
+    for (order_t o; s < e; s += BIT (o)) {
+
+        o = static_cast<order_t>(min (max_order (s, e - s), orders - 1UL));
+
+        auto const block { index_to_block (s) };
+
+        block->ord = o;
+        block->tag = Block::Tag::FREE;
+
+        freelist.enqueue (block, region (block)->grp);
+    }
+}
+
+/*
+ * Add donated memory to the allocator
+ *
+ * The range must lie within the linear kernel memory window above the boot
+ * pool and must not overlap existing pools. User and device access to it is
+ * revoked at the source that delegations originate from, but mappings that were
+ * already delegated to other spaces remain. The caller must revoke those first.
+ *
+ * @param phys      Physical base address (superpage-aligned)
+ * @param size      Size in bytes (superpage multiple)
+ * @return          True if successful, false otherwise
+ */
+bool Buddy::donate (uint64_t phys, size_t size)
+{
+    auto const virt { reinterpret_cast<uintptr_t>(Kmem::phys_to_ptr (phys)) };
+
+    if (EXPECT_FALSE (!size || (phys | size) & OFFS_MASK (1)))
+        return false;
+
+    if (EXPECT_FALSE (phys < Multiboot::ea || virt + size < virt || virt + size > LINK_END))
+        return false;
+
+    Lock_guard <Spinlock> guard { pool_lock };
+
+    Pool *slot { nullptr };
+
+    for (auto &p : pool) {
+
+        // Remember the first unused pool
+        if (!p.max_idx) {
+            if (!slot)
+                slot = &p;
+            continue;
+        }
+
+        // Reject overlap with the pages or the block array of an existing pool
+        if (virt < reinterpret_cast<uintptr_t>(p.blk_base + p.max_idx) && index_to_page (p.base_idx()) < virt + size)
+            return false;
+    }
+
+    if (EXPECT_FALSE (!slot))
+        return false;
 
-        // Get the first block from the order(o) freelist
-        auto const block { freelist.dequeue (o) };
+    // Revoke user and device access and map the range into the linear kernel memory window
+    Space_hst::user_access (phys, size, false);
+    Space_dma::user_access (phys, size, false);
 
-        // If that freelist was empty, try higher orders
-        if (!block)
+    for (size_t o { 0 }; o < size; o += PAGE_SIZE (1))
+        Hptp::master_map (virt + o, phys + o, PTE_BPL, Paging::Permissions (Paging::G | Paging::W | Paging::R), Memattr::ram());
+
+    auto const min { page_to_index (virt) };
+    auto const max { min + size / (PAGE_SIZE (0) + sizeof (Block)) };
+    auto const blk { reinterpret_cast<Block *>(virt + size) - (max - min) };
+
+    memset (blk, 0, (max - min) * sizeof (Block));
+
+    // Publish the pool, making it valid last
+    slot->blk_base = blk - min;
+    slot->min_idx  = min;
+    slot->max_idx  = max;
+
+    if (auto const n { static_cast<unsigned>(slot - pool + 1) }; used < n)
+        used = n;
+
+    trace (TRACE_MEMORY, "BUDDY: Donated %#lx-%#lx", phys, phys + size);
+
+    // Free all pages in the pool
+    insert (min, max);
+
+    return true;
+}
+
+/*
+ * Remove donated memory from the allocator
+ *
+ * This succeeds only if all pages of the pool are free. User access to the
+ * range is restored. The kernel mapping of the range is retained, but the
+ * allocator no longer hands out its pages.
+ *
+ * @param phys      Physical base address, as passed to donate
+ * @return          True if successful, false otherwise
+ */
+bool Buddy::reclaim (uint64_t phys)
+{
+    auto const idx { page_to_index (reinterpret_cast<uintptr_t>(Kmem::phys_to_ptr (phys))) };
+
+    Lock_guard <Spinlock> guard { pool_lock };
+
+    // The boot pool cannot be reclaimed
+    for (auto p { pool + 1 }; p < pool + pools; p++) {
+
+        if (!p->max_idx || p->min_idx != idx)
             continue;
 
-        // Split higher-order blocks and put the upper half back into the freelist
-        while (o-- != ord) {
-            auto const buddy { block + BIT (o) };
-            assert (buddy->ord == o);
-            freelist.enqueue (buddy);
+        auto const size { reinterpret_cast<uintptr_t>(p->blk_base + p->max_idx) - index_to_page (p->min_idx) };
+
+        {   Lock_guard <Spinlock> guard_buddy { lock };
+
+            // Check that the pool consists of free blocks only
+            for (auto i { p->min_idx }; i < p->max_idx; i += BIT (index_to_block (i)->ord))
+                if (index_to_block (i)->tag != Block::Tag::FREE)
+                    return false;
+
+            // Remove all blocks from the freelist
+            for (auto i { p->min_idx }; i < p->max_idx; i += BIT (index_to_block (i)->ord))
+                freelist.dequeue (index_to_block (i), region (index_to_block (i))->grp);
+
+            p->max_idx = 0;
         }
 
-        // Set final block size and mark block as used
-        block->ord = ord;
-        block->tag = Block::Tag::USED;
+        Space_hst::user_access (phys, size, true);
+        Space_dma::user_access (phys, size, true);
 
-        auto const ptr { reinterpret_cast<void *>(index_to_page (block_to_index (block))) };
+        trace (TRACE_MEMORY, "BUDDY: Reclaimed %#lx", phys);
 
-        // Fill the block if requested
-        if (fill != Fill::NONE)
-            memset (ptr, fill == Fill::BITS0 ? 0 : ~0U, BIT (block->ord + PAGE_BITS));
+        return true;
+    }
 
-        return ptr;
+    return false;
+}
+
+/*
+ * Take a block from the freelists (with the allocator lock held)
+ *
+ * Blocks are taken from regions of the requested group first. If there are
+ * none, a free region is claimed for the group. Only if no free region is
+ * left either, blocks are taken from regions of another group.
+ *
+ * @param ord       Block order (2^ord pages)
+ * @param grp       Allocation group
+ * @return          Pointer to the block (marked used) or nullptr if unsuccessful
+ */
+Buddy::Block *Buddy::take (order_t ord, Group grp)
+{
+    // Iterate over the allocation groups, starting with the requested group
+    for (unsigned i { 0 }; i < groups; i++) {
+
+        auto const g { static_cast<Group>((std::to_underlying (grp) + i) % groups) };
+
+        // Iterate over all freelists, starting with the requested order (free regions only for the requested group)
+        for (auto o { ord }; o < orders - !!i; o++) {
+
+            // Get the first block from the order(o) freelist
+            auto const block { freelist.dequeue (o, g) };
+
+            // If that freelist was empty, try higher orders
+            if (!block)
+                continue;
+
+            // Claim a free region for the requested group
+            if (o == orders - 1)
+                block->grp = g;
+
+            // Split higher-order blocks and put the upper half back into the freelist
+            while (o-- != ord) {
+                auto const buddy { block + BIT (o) };
+                buddy->ord = o;
+                buddy->tag = Block::Tag::FREE;
+                freelist.enqueue (buddy, g);
+            }
+
+            // Set final block size and mark block as used
+            block->ord = ord;
+            block->tag = Block::Tag::USED;
+
+            return block;
+        }
     }
 
     // Out of memory
     return nullptr;
 }
 
+/*
+ * Allocate physically and virtually contiguous memory region
+ *
+ * @param ord       Block order (2^ord pages)
+ * @param fill      Fill pattern for the block
+ * @param grp       Allocation group
+ * @return          Pointer to virtual memory region or nullptr if unsuccessful
+ */
+void *Buddy::alloc (order_t ord, Fill fill, Group grp)
+{
+    Block *block;
+
+    {   Lock_guard <Spinlock> guard { lock };
+
+        block = take (ord, grp);
+    }
+
+    // Memory is low, so hasten the reclamation of objects awaiting a grace period
+    if (EXPECT_FALSE (!block)) {
+        if (Cpu::online)
+            Rcu::expedite();
+        return nullptr;
+    }
+
+    auto const ptr { reinterpret_cast<void *>(index_to_page (block_to_index (block))) };
+
+    // Fill the block if requested
+    if (fill == Fill::BITS0)
+        memzero (ptr, BIT (ord + PAGE_BITS));
+    else if (fill == Fill::BITS1)
+        memset (ptr, ~0U, BIT (ord + PAGE_BITS));
+
+    return ptr;
+}
+
+/*
+ * Allocate a batch of pages under a single lock acquisition
+ *
+ * @param ptr       Array that receives pointers to the pages
+ * @param n         Number of pages requested
+ * @param grp       Allocation group
+ * @return          Number of pages allocated
+ */
+unsigned Buddy::alloc_batch (void **ptr, unsigned n, Group grp)
+{
+    Lock_guard <Spinlock> guard { lock };
+
+    unsigned i { 0 };
+
+    for (Block *block; i < n && (block = take (0, grp)); i++)
+        ptr[i] = reinterpret_cast<void *>(index_to_page (block_to_index (block)));
+
+    return i;
+}
+
 /*
  * Coalesce to-be-freed block
  *
@@ -125,7 +342,7 @@ void Buddy::coalesce (Block *block)
             break;
 
         // Dequeue buddy from the freelist
-        freelist.dequeue (buddy);
+        freelist.dequeue (buddy, region (buddy)->grp);
 
         // Merge block with buddy
         if (block > buddy)
@@ -133,7 +350,7 @@ void Buddy::coalesce (Block *block)
     }
 
     // Put final-size block into the freelist
-    freelist.enqueue (block);
+    freelist.enqueue (block, region (block)->grp);
 }
 
 /*
@@ -161,6 +378,19 @@ void Buddy::free (void *ptr)
  * @param ptr       Pointer to virtual memory region (or nullptr)
  */
 void Buddy::wait (void *ptr)
+{
+    wait (ptr, waitlist);
+}
+
+/*
+ * Put physically and virtually contiguous memory region on a waitlist
+ *
+ * The memory is not freed. Its owner retrieves it later via unwait.
+ *
+ * @param ptr       Pointer to virtual memory region (or nullptr)
+ * @param list      Waitlist
+ */
+void Buddy::wait (void *ptr, Waitlist &list)
 {
     if (EXPECT_FALSE (!ptr))
         return;
@@ -171,5 +401,36 @@ void Buddy::wait (void *ptr)
     assert (valid (idx));
 
     // Waitlist to-be-freed block
-    waitlist.enqueue (index_to_block (idx));
+    list.enqueue (index_to_block (idx));
+}
+
+/*
+ * Take a memory region off a waitlist
+ *
+ * @param list      Waitlist
+ * @return          Pointer to virtual memory region or nullptr if the waitlist is empty
+ */
+void *Buddy::unwait (Waitlist &list)
+{
+    auto const b { list.dequeue() };
+
+    return b ? reinterpret_cast<void *>(index_to_page (block_to_index (b))) : nullptr;
+}
+
+/*
+ * Report fragmentation statistics
+ *
+ * For each allocation group, the number of free blocks per order in the
+ * regions of that group, followed by the number of free regions.
+ */
+void Buddy::stats()
+{
+    static char const *const name[groups + 1] { "OBJ", "PTAB", "FREE" };
+
+    Lock_guard <Spinlock> guard { lock };
+
+    for (unsigned g { 0 }; g <= groups; g++)
+        for (order_t o { 0 }; o < orders; o++)
+            if (freelist.blocks (g, o))
+                trace (TRACE_PERF, "BUDDY: %s ORD:%u BLK:%u", name[g], o, freelist.blocks (g, o));
 }
@@ -21,6 +21,7 @@
  */
 
 #include "abi.hpp"
+#include "buddy.hpp"
 #include "counter.hpp"
 #include "ec_arch.hpp"
 #include "elf.hpp"
@@ -31,13 +32,15 @@
 #include "interrupt.hpp"
 #include "multiboot.hpp"
 #include "ptab_hpt.hpp"
+#include "rcu.hpp"
 #include "sm.hpp"
 #include "space_hst.hpp"
 #include "space_obj.hpp"
 #include "stdio.hpp"
+#include "string_perf.hpp"
 #include "timer.hpp"
 
-INIT_PRIORITY (PRIO_SLAB) Slab_cache Ec::cache { sizeof (Ec_arch), Kobject::alignment };
+INIT_PRIORITY (PRIO_SLAB) Slab_cache Ec::cache { sizeof (Ec_arch), Kobject::alignment_mp, 2 };
 
 Atomic<Ec *>    Ec::current     { nullptr };
 Ec *            Ec::fpowner     { nullptr };
@@ -78,23 +81,108 @@ Ec *Ec::create_hst (Status &s, Pd *pd, bool t, bool fpu, cpu_t cpu, unsigned lon
         return nullptr;
     }
 
+    auto const q { pd->get_quota().charge (PAGE_SIZE (0)) };
     auto const f { fpu ? new (pd->fpu_cache) Fpu : nullptr };
-    auto const u { new Utcb };
+    auto const u { q ? new Utcb : nullptr };
     Ec *ec;
 
-    if (EXPECT_TRUE ((!fpu || f) && u && (ec = new (cache) Ec_arch { t, f, ref_obj, ref_hst, ref_pio, cpu, evt, sp, hva, u }))) {
+    if (EXPECT_TRUE ((!fpu || f) && u && (ec = new (pd->ec_cache) Ec_arch { t, f, ref_obj, ref_hst, ref_pio, cpu, evt, sp, hva, u }))) {
+
         assert (!ref_obj && !ref_hst && !ref_pio);
-        return ec;
+
+        if (EXPECT_TRUE (ec->kpage_mapped (hva)))
+            return ec;
+
+        // The address was already taken by the kernel page of another EC
+        ec->destroy();
+        delete u;
+        pd->get_quota().uncharge (PAGE_SIZE (0));
+        s = Status::BAD_PAR;
+        return nullptr;
     }
 
     delete u;
     Fpu::operator delete (f, pd->fpu_cache);
 
+    if (q)
+        pd->get_quota().uncharge (PAGE_SIZE (0));
+
     s = Status::MEM_OBJ;
 
     return nullptr;
 }
 
+/*
+ * Determine if the kernel page of this EC is mapped at the specified address of its host space
+ *
+ * Mapping the kernel page fails if the address already maps the kernel page of
+ * another EC, because updates never replace the kernel pages owned by a space.
+ *
+ * @param hva   Host virtual address
+ * @return      True if the kernel page is mapped at the address, false otherwise
+ */
+bool Ec::kpage_mapped (uintptr_t hva) const
+{
+    uint64_t p;
+    unsigned o;
+    Memattr ma;
+
+    return regs.get_hst()->lookup (hva, p, o, ma) & Paging::K && p == Kmem::ptr_to_phys (kpage);
+}
+
+/*
+ * Destroy this EC
+ *
+ * The UTCB or vAPIC page is not freed here, because it remains mapped into the
+ * host space until the page tables of that space are deallocated.
+ */
+void Ec::destroy()
+{
+    // Kernel ECs live in the kernel host space, which has no PD
+    auto const pd { regs.get_hst()->get_pd() };
+
+    if (fpu)
+        Fpu::operator delete (fpu, pd->fpu_cache);
+
+    if (is_vcpu())
+        static_cast<Ec_arch *>(this)->vcpu_fini();
+
+    // Release the group member that this EC consumed but never retired
+    if (auto const m { Sm::retire (this) })
+        m->release();
+
+    this->~Ec();
+
+    if (pd)
+        operator delete (this, pd->ec_cache);
+    else
+        operator delete (this, cache);
+}
+
+/*
+ * Determine if the EC is still in use by the kernel without holding a reference
+ *
+ * The current EC is checked first, because an EC that stopped being current on
+ * all cores without a reference can neither become current nor block again.
+ *
+ * @return      True if the EC is current or FPU owner on any core, blocked, part of a donation chain, or its vCPU state is still loaded
+ */
+bool Ec::busy()
+{
+    for (cpu_t c { 0 }; c < Cpu::count; c++)
+        if (remote_current (c) == this)
+            return true;
+
+    for (cpu_t c { 0 }; c < Cpu::count; c++)
+        if (*Kmem::loc_to_glob (c, &fpowner) == this)
+            return true;
+
+    if (cont.load (__ATOMIC_ACQUIRE) == blocking || callee || caller)
+        return true;
+
+    return is_vcpu() && static_cast<Ec_arch *>(this)->vcpu_busy();
+}
+
 void Ec::create_idle()
 {
     Status s;
@@ -110,10 +198,17 @@ void Ec::create_idle()
 
 void Ec::create_root()
 {
-    trace (TRACE_PERF, "TIME: %lums %lums/%lums",
+    trace (TRACE_PERF, "TIME: %lums %lums/%lums BUDDY: %luus",
            Stc::ticks_to_ms (Timer::time() - Multiboot::t0),
            Stc::ticks_to_ms (Multiboot::t1 - Multiboot::t0),
-           Stc::ticks_to_ms (Multiboot::t2 - Multiboot::t1));
+           Stc::ticks_to_ms (Multiboot::t2 - Multiboot::t1),
+           Stc::ticks_to_us (Buddy::init_ticks()));
+
+    // Report the fragmentation of the kernel memory pool before the root PD starts allocating
+    Buddy::stats();
+
+    // Report the performance of the string primitive variants
+    String_perf::report();
 
     auto const ra { Multiboot::ra };
 
@@ -249,7 +344,11 @@ void Ec::idle (Ec *const self)
         if (EXPECT_FALSE (hzd))
             self->handle_hazard (hzd, idle);
 
+        Rcu::eqs_enter();
+
         Cpu::halt();
+
+        Rcu::eqs_exit();
     }
 }
 
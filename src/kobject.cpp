@@ -0,0 +1,127 @@
+/*
+ * Kernel Object
+ *
+ * Copyright (C) 2019-2024 Udo Steinberg, BedRock Systems, Inc.
+ *
+ * This file is part of the NOVA microhypervisor.
+ *
+ * NOVA is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NOVA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License version 2 for more details.
+ */
+
+#include "ec.hpp"
+#include "pd.hpp"
+#include "pt.hpp"
+#include "sc.hpp"
+#include "sm.hpp"
+#include "space_dma.hpp"
+#include "space_gst.hpp"
+#include "space_hst.hpp"
+#include "space_msr.hpp"
+#include "space_obj.hpp"
+#include "space_pio.hpp"
+
+/*
+ * Destroy an object that is no longer in use
+ *
+ * @param o     Object to destroy
+ * @return      True if the object was destroyed, false if it is still busy
+ */
+template <typename T>
+static bool destroy_idle (T *o)
+{
+    if (EXPECT_FALSE (o->busy()))
+        return false;
+
+    o->destroy();
+
+    return true;
+}
+
+/*
+ * Destroy a space that its PD hands out without a reference (OBJ, HST, PIO)
+ *
+ * A space that is still published is unpublished first and must then wait for
+ * another grace period, because a concurrent reader may have obtained the space
+ * from its PD just before.
+ *
+ * @param o     Space to destroy
+ * @return      True if the space was destroyed, false if it must wait for another grace period
+ */
+template <typename T>
+static bool destroy_unpublished (T *o)
+{
+    if (EXPECT_FALSE (o->get_pd()->unpublish (o)))
+        return false;
+
+    o->destroy();
+
+    return true;
+}
+
+/*
+ * Destroy a DMA space unless a device was assigned to it
+ *
+ * @param o     DMA space to destroy
+ * @return      True, because a DMA space that is still used by a device is kept
+ */
+static bool destroy_unused (Space_dma *o)
+{
+    if (EXPECT_TRUE (!o->is_used()))
+        o->destroy();
+
+    return true;
+}
+
+/*
+ * Destroy this object after its last reference was dropped and a grace period elapsed
+ *
+ * An unreferenced SC is no longer scheduled once it leaves the ready queue. An SC
+ * that is blocked on its EC remains busy until that EC is unblocked. DMA spaces
+ * to which a device was assigned are kept, because the SMMU may still use them.
+ *
+ * @return      True if the object was destroyed or is kept, false if it must wait for another grace period
+ */
+bool Kobject::destroy_quiescent()
+{
+    switch (type) {
+
+        case Type::PD:
+
+            switch (subtype) {
+                case Subtype::PD:   static_cast<Pd *>(this)->destroy();         return true;
+                case Subtype::OBJ:  return destroy_unpublished (static_cast<Space_obj *>(this));
+                case Subtype::HST:  return !static_cast<Space_hst *>(this)->busy() && destroy_unpublished (static_cast<Space_hst *>(this));
+                case Subtype::GST:  static_cast<Space_gst *>(this)->destroy();  return true;
+                case Subtype::DMA:  return destroy_unused (static_cast<Space_dma *>(this));
+                case Subtype::PIO:  return destroy_unpublished (static_cast<Space_pio *>(this));
+                case Subtype::MSR:  static_cast<Space_msr *>(this)->destroy();  return true;
+                default:                                                        return true;
+            }
+
+        case Type::EC:  return destroy_idle (static_cast<Ec *>(this));
+        case Type::SC:  return destroy_idle (static_cast<Sc *>(this));
+        case Type::PT:  static_cast<Pt *>(this)->destroy();                     return true;
+        case Type::SM:  return destroy_idle (static_cast<Sm *>(this));
+        default:                                                                return true;
+    }
+}
+
+/*
+ * RCU callback for an object whose last reference was dropped
+ *
+ * An object that is still busy is resubmitted and reconsidered after the next grace period.
+ *
+ * @param e     RCU element of the object
+ */
+void Kobject::Reclaim::reclaim (Rcu_elem *e)
+{
+    if (EXPECT_FALSE (!static_cast<Reclaim *>(e)->obj->destroy_quiescent()))
+        Rcu::submit (e);
+}
@@ -23,6 +23,7 @@
 #include "fpu.hpp"
 #include "hip.hpp"
 #include "pt.hpp"
+#include "sc.hpp"
 #include "sm.hpp"
 #include "space_dma.hpp"
 #include "space_gst.hpp"
@@ -32,17 +33,24 @@
 #include "space_pio.hpp"
 #include "stdio.hpp"
 
-INIT_PRIORITY (PRIO_SLAB) Slab_cache Pd::cache { sizeof (Pd), Kobject::alignment };
-
-Pd::Pd() : Kobject { Kobject::Type::PD },
-           dma_cache { sizeof (Space_dma), Kobject::alignment },
-           gst_cache { sizeof (Space_gst), Kobject::alignment },
-           hst_cache { sizeof (Space_hst), Kobject::alignment },
-           msr_cache { sizeof (Space_msr), Kobject::alignment },
-           obj_cache { sizeof (Space_obj), Kobject::alignment },
-           pio_cache { sizeof (Space_pio), Kobject::alignment },
-           fpu_cache { Fpu::size, Fpu::alignment }
+INIT_PRIORITY (PRIO_SLAB) Slab_cache Pd::cache { sizeof (Pd), Kobject::alignment, 2 };
+
+Pd::Pd (Refptr<Pd> &o) : Kobject { Kobject::Type::PD }, owner { std::move (o) },
+           dma_cache { sizeof (Space_dma), quota },
+           gst_cache { sizeof (Space_gst), quota },
+           hst_cache { sizeof (Space_hst), quota },
+           msr_cache { sizeof (Space_msr), quota },
+           obj_cache { sizeof (Space_obj), quota },
+           pio_cache { sizeof (Space_pio), quota },
+           fpu_cache { Fpu::size, quota },
+           ec_cache  { sizeof (Ec_arch), quota },
+           pd_cache  { sizeof (Pd), quota },
+           pt_cache  { sizeof (Pt), quota },
+           sc_cache  { sizeof (Sc), quota },
+           sm_cache  { sizeof (Sm), quota }
 {
+    static_assert (Kobject::alignment_mp <= 64 && Fpu::alignment <= 64, "Shared size classes are insufficiently aligned");
+
     trace (TRACE_CREATE, "PD:%p created", static_cast<void *>(this));
 }
 
@@ -162,7 +170,7 @@ Space_msr *Pd::create_msr (Status &s, Space_obj *obj, unsigned long sel)
 
 Pd *Pd::create_pd (Status &s, Space_obj *obj, unsigned long sel, unsigned prm)
 {
-    auto const o { Pd::create (s) };
+    auto const o { Pd::create (s, obj->get_pd()) };
 
     if (EXPECT_TRUE (o)) {
 
@@ -192,7 +200,7 @@ Ec *Pd::create_ec (Status &s, Space_obj *obj, unsigned long sel, Pd *pd, cpu_t c
 
 Sc *Pd::create_sc (Status &s, Space_obj *obj, unsigned long sel, Ec *ec, cpu_t cpu, uint16_t budget, uint8_t prio, cos_t cos)
 {
-    auto const o { Sc::create (s, ec, cpu, budget, prio, cos) };
+    auto const o { Sc::create (s, obj->get_pd(), ec, cpu, budget, prio, cos) };
 
     if (EXPECT_TRUE (o)) {
 
@@ -207,7 +215,7 @@ Sc *Pd::create_sc (Status &s, Space_obj *obj, unsigned long sel, Ec *ec, cpu_t c
 
 Pt *Pd::create_pt (Status &s, Space_obj *obj, unsigned long sel, Ec *ec, uintptr_t ip)
 {
-    auto const o { Pt::create (s, ec, ip) };
+    auto const o { Pt::create (s, obj->get_pd(), ec, ip) };
 
     if (EXPECT_TRUE (o)) {
 
@@ -220,9 +228,9 @@ Pt *Pd::create_pt (Status &s, Space_obj *obj, unsigned long sel, Ec *ec, uintptr
     return nullptr;
 }
 
-Sm *Pd::create_sm (Status &s, Space_obj *obj, unsigned long sel, uint64_t ct, unsigned id)
+Sm *Pd::create_sm (Status &s, Space_obj *obj, unsigned long sel, uint64_t ct, unsigned id, uint8_t flg)
 {
-    auto const o { Sm::create (s, ct, id) };
+    auto const o { Sm::create (s, obj->get_pd(), ct, id, flg & BIT (0), flg & BIT (1)) };
 
     if (EXPECT_TRUE (o)) {
 
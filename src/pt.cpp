@@ -23,9 +23,9 @@
 #include "pt.hpp"
 #include "stdio.hpp"
 
-INIT_PRIORITY (PRIO_SLAB) Slab_cache Pt::cache { sizeof (Pt), Kobject::alignment };
+INIT_PRIORITY (PRIO_SLAB) Slab_cache Pt::cache { sizeof (Pt), Kobject::alignment_mp, 2 };
 
-Pt::Pt (Refptr<Ec> &e, uintptr_t i) : Kobject { Kobject::Type::PT }, ec { std::move (e) }, ip { i }
+Pt::Pt (Refptr<Pd> &o, Refptr<Ec> &e, uintptr_t i) : Kobject { Kobject::Type::PT }, ec { std::move (e) }, ip { i }, owner { std::move (o) }
 {
     trace (TRACE_CREATE, "PT:%p created (EC:%p IP:%#lx)", static_cast<void *>(this), static_cast<void *>(ec), ip);
 }
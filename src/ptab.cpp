@@ -20,6 +20,7 @@
  */
 
 #include "cpu.hpp"
+#include "lowlevel.hpp"
 #include "ptab.hpp"
 #include "ptab_tmp.hpp"
 
@@ -58,18 +59,21 @@
 /*
  * Walk page tables and return pointer to the PTE for the specified virtual address
  *
+ * @param ptr   Pointer to the PTE for the virtual address at the start level
+ * @param l     Start level to walk down from
  * @param v     Virtual address whose PTE is being looked up
  * @param t     Target level to walk down to
  * @param e     True if making entries, false if making holes
+ * @param q     Quota charged for new page tables (or nullptr for none)
  * @return      Pointer to the PTE (if exists) or ~0 (skippable hole) or nullptr (allocation failure)
  */
 template <typename T, typename I, typename O>
-typename Ptab<T,I,O>::PTE *Ptab<T,I,O>::walk (IAddr v, unsigned t, bool e)
+typename Ptab<T,I,O>::PTE *Ptab<T,I,O>::walk (PTE *ptr, unsigned l, IAddr v, unsigned t, bool e, Quota *q)
 {
-    auto l { T::lev() }; T pte;
+    T pte;
 
-    // Walk down the page tables from the root, computing the slot index at each level
-    for (auto ptr { &entry };; ptr = &pte->entry + T::lev_idx (--l, v)) {
+    // Walk down the page tables from the start level, computing the slot index at each level
+    for (;; ptr = &pte->entry + T::lev_idx (--l, v)) {
 
         // Terminate the walk upon reaching the target level and return pointer to the PTE
         if (l == t)
@@ -78,6 +82,14 @@ typename Ptab<T,I,O>::PTE *Ptab<T,I,O>::walk (IAddr v, unsigned t, bool e)
         // Atomically read the PTE from the slot
         for (pte = static_cast<T>(*ptr);;) {
 
+            // Wait for a concurrent promotion of the page table that the PTE refers to
+            if constexpr (T::promotable)
+                if (EXPECT_FALSE (locked (pte, l))) {
+                    pause();
+                    pte = static_cast<T>(*ptr);
+                    continue;
+                }
+
             // Determine the PTE type
             auto const type { pte.type (l) };
 
@@ -93,12 +105,21 @@ typename Ptab<T,I,O>::PTE *Ptab<T,I,O>::walk (IAddr v, unsigned t, bool e)
                 OAddr const p { (type == Entry::Type::LEAF) * (pte.addr (l) | T::page_attr (n, pte.page_pm(), pte.page_ma (l))) };
                 OAddr const s { (type == Entry::Type::LEAF) * T::page_size (n * T::bpl) };
 
+                auto const o { T::lev_bit (n) - T::bpl };
+
+                // Terminate the walk if the quota is exhausted
+                if (EXPECT_FALSE (q && !q->charge (T::page_size (o))))
+                    return nullptr;
+
                 // Allocate a new page table
-                auto const ptab { new (T::lev_bit (n) - T::bpl) Ptab (T::lev_ent (n), p, s) };
+                auto const ptab { new (o) Ptab (T::lev_ent (n), p, s) };
 
                 // Terminate the walk if allocation failed
-                if (EXPECT_FALSE (!ptab))
+                if (EXPECT_FALSE (!ptab)) {
+                    if (q)
+                        q->uncharge (T::page_size (o));
                     return nullptr;
+                }
 
                 // Construct a new PTE that refers to the new page table
                 T tmp { Kmem::ptr_to_phys (ptab) | (l != T::lev()) * T::ptab_attr };
@@ -108,7 +129,9 @@ typename Ptab<T,I,O>::PTE *Ptab<T,I,O>::walk (IAddr v, unsigned t, bool e)
                 // * Failure: someone beat us to it; deallocate our new page table and start over
                 // Note: A compare_exchange failure changes pte to the existing value at ptr
                 if (!ptr->compare_exchange (pte, tmp)) {
-                    operator delete (ptab, false);
+                    operator delete (ptab, o, false);
+                    if (q)
+                        q->uncharge (T::page_size (o));
                     continue;
                 }
 
@@ -169,6 +192,24 @@ Paging::Permissions Ptab<T,I,O>::lookup (IAddr v, OAddr &p, unsigned &o, Memattr
     }
 }
 
+/*
+ * Count the leaf mappings of a virtual address range by page size
+ *
+ * @param v     Virtual base address of the range
+ * @param e     Virtual end address of the range (exclusive)
+ * @param n     Array of T::lev() counters, indexed by page-table level
+ */
+template <typename T, typename I, typename O>
+void Ptab<T,I,O>::census (IAddr v, IAddr e, unsigned *n) const
+{
+    OAddr p; unsigned o; Memattr ma;
+
+    // Advance by the size of each leaf or hole
+    for (; v < e; v = (v | T::offs_mask (o)) + 1)
+        if (lookup (v, p, o, ma))
+            n[o / T::bpl]++;
+}
+
 /*
  * Update PTEs for the specified virtual address range
  *
@@ -177,10 +218,12 @@ Paging::Permissions Ptab<T,I,O>::lookup (IAddr v, OAddr &p, unsigned &o, Memattr
  * @param ord   Page order (2^ord pages) of the range
  * @param pm    Page permissions (0 for zapping PTEs)
  * @param ma    Memory attributes
- * @return      SUCCESS (successful) or MEM_CAP (allocation failure)
+ * @param q     Quota charged for new page tables (or nullptr for none)
+ * @param inv   Set to true if a present PTE was removed or downgraded, so that stale translations must be invalidated
+ * @return      SUCCESS (successful) or MEM_CAP (allocation failure or quota exhausted)
  */
 template <typename T, typename I, typename O>
-Status Ptab<T,I,O>::update (IAddr v, OAddr p, unsigned ord, Paging::Permissions pm, Memattr ma)
+Status Ptab<T,I,O>::update (IAddr v, OAddr p, unsigned ord, Paging::Permissions pm, Memattr ma, Quota *q, bool *inv)
 {
     // Both virtual and physical address must be order-aligned
     assert ((v & T::offs_mask (ord)) == 0);
@@ -191,69 +234,277 @@ Status Ptab<T,I,O>::update (IAddr v, OAddr p, unsigned ord, Paging::Permissions
     auto const n { BIT (o - l * T::bpl) };
     auto const a { T::page_attr (l, pm, ma) };
 
+    // Level of the PTEs that refer to the page tables being updated
+    auto const u { min (l + 1, T::lev()) };
+
+    auto sts { Status::SUCCESS };
+
+    PTE *dir { nullptr };
+
     // Split operations that cross page-table boundaries into the largest possible size
     for (unsigned i { 0 }; i < BITN (ord - o); i++, v += BITN (o + PAGE_BITS), p += BITN (o + PAGE_BITS)) {
 
-        // Get pointer to the first PTE
-        auto const ptr { walk (v, l, a) };
+        // Walk down from the root for the first chunk and whenever the chunk crosses into another table at level u,
+        // otherwise proceed with the adjacent PTE at level u
+        dir = dir && T::lev_idx (u, v) ? dir + 1 : walk (v, u, a, q);
+
+        // Allocation failure
+        if (EXPECT_FALSE (!dir)) {
+            sts = Status::MEM_CAP;
+            break;
+        }
+
+        // Skippable hole above level u
+        if (dir == reinterpret_cast<decltype (dir)>(~0UL)) {
+            dir = nullptr;
+            continue;
+        }
+
+        PTE *ptr;
+
+        // Update the PTEs, retrying if a concurrent promotion replaced the leaf page table meanwhile
+        do {
+
+            // Get pointer to the first PTE
+            ptr = walk (dir, u, v, l, a, q);
+
+            // Allocation failure or skippable hole
+            if (EXPECT_FALSE (!ptr) || ptr == reinterpret_cast<decltype (ptr)>(~0UL))
+                break;
+
+            // Compute initial entry value and size increment
+            OAddr e { a ? p | a : 0 };
+            OAddr s { a ? T::page_size (l * T::bpl) : 0 };
+
+            T old;
+
+            // Iterate over all slots covering the range
+            for (unsigned j { 0 }; j < n; j++, e += s) {
+
+                // Construct a new PTE
+                T pte { e };
+
+                // Atomically replace old with new PTE, but keep the kernel pages owned by a space with a quota
+                if (!replace (ptr + j, old, pte, l, q))
+                    continue;
+
+                if (inv && !*inv)
+                    *inv = downgrade (old, pte, l);
+
+                // If the old PTE refers to a page table, then deallocate it
+                if (old.type (l) == Entry::Type::PTAB)
+                    old->deallocate (l - 1, q);
+            }
+
+            // Ensure PTE observability: Clean the updated PTEs of each table
+            if (T::noncoherent)
+                Cache::data_clean (ptr, n * sizeof (entry));
+
+        } while (EXPECT_FALSE (promotable (l, q) && replaced (dir, ptr)));
 
         // Allocation failure
-        if (EXPECT_FALSE (!ptr))
-            return Status::MEM_CAP;
+        if (EXPECT_FALSE (!ptr)) {
+            sts = Status::MEM_CAP;
+            break;
+        }
 
         // Skippable hole
         if (ptr == reinterpret_cast<decltype (ptr)>(~0UL))
             continue;
 
-        // Compute initial entry value and size increment
-        OAddr e { a ? p | a : 0 };
-        OAddr s { a ? T::page_size (l * T::bpl) : 0 };
+        // Try to promote the leaf page table to a large page, whose deallocation requires invalidation
+        if (promotable (l, q) && a && promote (dir, q) && inv)
+            *inv = true;
+    }
 
-        T old;
+    // Ensure PTE observability: Publish the updated PTEs of all tables at once
+    if (!T::noncoherent)
+        T::publish();
 
-        // Iterate over all slots covering the range
-        for (unsigned j { 0 }; j < n; j++, e += s) {
+    return sts;
+}
 
-            // Construct a new PTE
-            T pte { e };
+/*
+ * Promote a leaf page table that maps a physically contiguous, uniformly attributed
+ * and aligned range to a single large page and retire the leaf page table
+ *
+ * The PTE that refers to the leaf page table is locked during the check. Walks
+ * through the PTE and updates that replace it wait for the lock, and updates of
+ * the leaf page table that race with the promotion observe it and retry. Such
+ * updates may still write to the leaf page table until they observe the lock,
+ * so it is freed only after a grace period.
+ *
+ * Only x86 page tables are promotable. On aarch64, replacing a table descriptor
+ * with a block descriptor requires break-before-make, so leaf page tables stay.
+ *
+ * @param dir   Pointer to the PTE that refers to the leaf page table
+ * @param q     Quota to uncharge (or nullptr for none)
+ * @return      True if the leaf page table was promoted, false otherwise
+ */
+template <typename T, typename I, typename O>
+bool Ptab<T,I,O>::promote (PTE *dir, Quota *q)
+{
+    if constexpr (T::promotable) {
+
+        static_assert (T::lev_bit (0) == T::bpl, "Leaf page tables must be order-0 pages");
+
+        auto pte { static_cast<T>(*dir) };
+
+        // The PTE must refer to a leaf page table that is not being promoted already
+        if (pte.type (1) != Entry::Type::PTAB || locked (pte, 1))
+            return false;
+
+        auto const ptr { &pte->entry };
+        auto const num { T::lev_ent (0) };
+
+        // Determine if the first PTE maps an aligned page and all PTEs in the specified slot range continue its run
+        auto const contiguous { [&] (T fst, unsigned i, unsigned e)
+        {
+            if (fst.type (0) != Entry::Type::LEAF || fst.addr() & T::offs_mask (T::bpl))
+                return false;
+
+            for (; i < e; i++)
+                if (!(static_cast<T>(ptr[i]) == T { fst.val + i * T::page_size (0) }))
+                    return false;
+
+            return true;
+        }};
+
+        // Quickly reject leaf page tables whose last PTE does not continue the run
+        if (!contiguous (static_cast<T>(ptr[0]), num - 1, num))
+            return false;
 
-            // Atomically replace old with new PTE
-            ptr[j].exchange (old, pte);
+        // Allocate the RCU element up front, because the promotion cannot be undone once published
+        auto const r { Ptab_cache::prepare (ptr) };
 
-            // If the old PTE refers to a page table, then deallocate it
-            if (old.type (l) == Entry::Type::PTAB)
-                old->deallocate (l - 1);
+        if (EXPECT_FALSE (!r))
+            return false;
+
+        T lck { pte.val | T::lock };
+
+        // Lock the PTE that refers to the leaf page table, which makes concurrent walks and updates of the PTE wait
+        if (!dir->compare_exchange (pte, lck)) {
+            Ptab_cache::cancel (r);
+            return false;
+        }
+
+        // Check all PTEs again, now that concurrent updates of the leaf page table observe the lock
+        auto const fst { static_cast<T>(ptr[0]) };
+        auto const ok  { contiguous (fst, 1, num) };
+
+        // Unlock the PTE, replacing it with a large page if all PTEs continue the run
+        T val { ok ? T { fst.addr() | T::page_attr (1, fst.page_pm(), fst.page_ma (0)) } : pte };
+
+        if (EXPECT_FALSE (!dir->compare_exchange (lck, val) || !ok)) {
+            Ptab_cache::cancel (r);
+            return false;
         }
 
         // Ensure PTE observability
-        T::noncoherent ? Cache::data_clean (ptr, n * sizeof (entry)) : T::publish();
+        T::noncoherent ? Cache::data_clean (dir) : T::publish();
+
+        // Free the leaf page table after a grace period, because concurrent updates that have not yet observed the lock may still write to it
+        Ptab_cache::retire (r);
+
+        if (q)
+            q->uncharge (T::page_size (0));
+
+        return true;
     }
 
-    return Status::SUCCESS;
+    return false;
+}
+
+/*
+ * Atomically replace a PTE, waiting for a concurrent promotion of the page table it refers to
+ *
+ * A kernel page owned by a space remains mapped until the teardown of that space,
+ * which frees it. Replacing its PTE would leak the page.
+ *
+ * @param ptr   Pointer to the PTE
+ * @param o     Reference to the old PTE that is being returned
+ * @param n     New PTE
+ * @param l     Level of the PTE
+ * @param k     True to keep a PTE that refers to a kernel page owned by the space
+ * @return      True if the PTE was replaced, false if it was kept
+ */
+template <typename T, typename I, typename O>
+bool Ptab<T,I,O>::replace (PTE *ptr, T &o, T n, unsigned l, bool k)
+{
+    for (o = static_cast<T>(*ptr);; o = static_cast<T>(*ptr)) {
+
+        if (k && kernel (o, l))
+            return false;
+
+        if (locked (o, l))
+            pause();
+        else if (ptr->compare_exchange (o, n))
+            return true;
+    }
+}
+
+/*
+ * Determine if a concurrent promotion replaced the leaf page table that contains the specified PTE
+ *
+ * @param dir   Pointer to the PTE that referred to the leaf page table
+ * @param ptr   Pointer to a PTE in the leaf page table
+ * @return      True if the leaf page table was replaced, false otherwise
+ */
+template <typename T, typename I, typename O>
+bool Ptab<T,I,O>::replaced (PTE *dir, PTE *ptr)
+{
+    if constexpr (T::promotable) {
+
+        T pte;
+
+        // Wait for a concurrent promotion to finish
+        while (locked (pte = static_cast<T>(*dir), 1))
+            pause();
+
+        return pte.type (1) != Entry::Type::PTAB || pte.addr() != (Kmem::ptr_to_phys (ptr) & ~T::offs_mask (0));
+    }
+
+    return false;
 }
 
 /*
  * Deallocate a page table subtree
  *
+ * During the teardown of a space that is no longer in use, the page tables are
+ * freed immediately and the kernel pages mapped writable into the space (UTCBs
+ * and vAPIC pages) are freed with them. The only other kernel page mapped into
+ * a space is the read-only HIP, which remains in use.
+ *
  * @param l     Subtree level
+ * @param q     Quota to uncharge (or nullptr for none)
+ * @param f     True for the teardown of a space, false otherwise
  */
 template <typename T, typename I, typename O>
-void Ptab<T,I,O>::deallocate (unsigned l)
+void Ptab<T,I,O>::deallocate (unsigned l, Quota *q, bool f)
 {
-    if (l) {
+    // Iterate over all slots
+    for (unsigned i { 0 }; (l || f) && i < T::lev_ent (l); i++) {
 
-        // Iterate over all slots
-        for (unsigned i { 0 }; i < T::lev_ent (l); i++) {
+        // Atomically read the old PTE from the slot
+        auto const old { static_cast<T>(this[i].entry) };
 
-            // Atomically read the old PTE from the slot
-            auto const old { static_cast<T>(this[i].entry) };
+        // If the old PTE refers to a page table, then deallocate it
+        if (old.type (l) == Entry::Type::PTAB)
+            old->deallocate (l - 1, q, f);
 
-            // If the old PTE refers to a page table, then deallocate it
-            if (old.type (l) == Entry::Type::PTAB)
-                old->deallocate (l - 1);
+        // If the old PTE refers to a kernel page owned by the space, then free it
+        else if (f && kernel (old, l)) {
+
+            Buddy::free (Kmem::phys_to_ptr (old.addr (l)));
+
+            if (q)
+                q->uncharge (PAGE_SIZE (0));
         }
     }
 
-    // Waitlist pages after bootstrap when SMP/CPULOCAL is active
-    operator delete (this, Cpu::online);
+    // Waitlist pages after bootstrap when SMP/CPULOCAL is active, unless the space is no longer in use
+    operator delete (this, T::lev_bit (l) - T::bpl, !f && Cpu::online);
+
+    if (q)
+        q->uncharge (T::page_size (T::lev_bit (l) - T::bpl));
 }
@@ -0,0 +1,152 @@
+/*
+ * Page-Table Page Cache
+ *
+ * Copyright (C) 2019-2024 Udo Steinberg, BedRock Systems, Inc.
+ *
+ * This file is part of the NOVA microhypervisor.
+ *
+ * NOVA is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NOVA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License version 2 for more details.
+ */
+
+#include "buddy.hpp"
+#include "cpu.hpp"
+#include "initprio.hpp"
+#include "ptab_cache.hpp"
+#include "rcu.hpp"
+#include "slab.hpp"
+#include "string.hpp"
+
+void *      Ptab_cache::page[size];
+unsigned    Ptab_cache::num;
+INIT_PRIORITY (PRIO_LOCAL) Buddy::Waitlist Ptab_cache::list;
+
+/*
+ * RCU element that frees a retired page-table page after a grace period
+ */
+class Ptab_cache::Retired final : public Rcu_elem
+{
+    private:
+        void * const page;
+
+        static void free (Rcu_elem *e)
+        {
+            auto const r { static_cast<Retired *>(e) };
+
+            Ptab_cache::free (r->page);
+
+            cache.free (r);
+        }
+
+    public:
+        static Slab_cache cache;
+
+        explicit Retired (void *p) : Rcu_elem { free }, page { p } {}
+
+        [[nodiscard]] static void *operator new (size_t) noexcept { return cache.alloc(); }
+};
+
+INIT_PRIORITY (PRIO_SLAB) Slab_cache Ptab_cache::Retired::cache { sizeof (Ptab_cache::Retired), alignof (Ptab_cache::Retired) };
+
+/*
+ * Allocate a zeroed page-table page
+ *
+ * @return          Pointer to the page or nullptr if unsuccessful
+ */
+void *Ptab_cache::alloc()
+{
+    if (EXPECT_FALSE (!Cpu::online))
+        return Buddy::alloc (0, Buddy::Fill::BITS0, Buddy::Group::PTAB);
+
+    // Refill an empty cache with a batch of pages
+    if (EXPECT_FALSE (!num)) {
+
+        num = Buddy::alloc_batch (page, batch, Buddy::Group::PTAB);
+
+        for (unsigned i { 0 }; i < num; i++)
+            memzero (page[i], PAGE_SIZE (0));
+    }
+
+    return num ? page[--num] : nullptr;
+}
+
+/*
+ * Free a page-table page immediately
+ *
+ * @param ptr       Pointer to the page
+ */
+void Ptab_cache::free (void *ptr)
+{
+    // Return the page to the buddy allocator if the cache is full
+    if (EXPECT_FALSE (!Cpu::online || num == size)) {
+        Buddy::free (ptr);
+        return;
+    }
+
+    memzero (ptr, PAGE_SIZE (0));
+
+    page[num++] = ptr;
+}
+
+/*
+ * Free a page-table page deferred, until stale TLB entries are gone
+ *
+ * @param ptr       Pointer to the page
+ */
+void Ptab_cache::wait (void *ptr)
+{
+    // The page stays intact, because other cores may still walk it
+    Buddy::wait (ptr, list);
+}
+
+/*
+ * Prepare to free a page-table page deferred, until a grace period has elapsed
+ *
+ * This is required for pages that lock-free updates may still write to. The
+ * RCU element is allocated up front, so that a caller can make the page
+ * unreachable first and then retire it without a failure path.
+ *
+ * @param ptr       Pointer to the page
+ * @return          Retirement handle or nullptr if out of memory
+ */
+Ptab_cache::Retired *Ptab_cache::prepare (void *ptr)
+{
+    return new Retired (ptr);
+}
+
+/*
+ * Free a prepared page-table page after a grace period
+ *
+ * Because the grace period ends only after this CPU has left the kernel, it
+ * also covers a TLB invalidation that this CPU performs before then.
+ *
+ * @param r         Retirement handle
+ */
+void Ptab_cache::retire (Retired *r)
+{
+    Rcu::submit (r);
+}
+
+/*
+ * Abandon a prepared retirement, keeping the page-table page in use
+ *
+ * @param r         Retirement handle
+ */
+void Ptab_cache::cancel (Retired *r)
+{
+    Retired::cache.free (r);
+}
+
+/*
+ * Free all deferred page-table pages
+ */
+void Ptab_cache::free_wait()
+{
+    for (void *ptr; (ptr = Buddy::unwait (list)); free (ptr));
+}
@@ -24,6 +24,8 @@
 #include "cpu.hpp"
 #include "hazard.hpp"
 #include "initprio.hpp"
+#include "interrupt.hpp"
+#include "kmem.hpp"
 #include "rcu.hpp"
 #include "stdio.hpp"
 
@@ -33,15 +35,27 @@ INIT_PRIORITY (PRIO_LOCAL) Rcu::List Rcu::done;
 
 Rcu::Epoch Rcu::epoch_l { 0 };
 Rcu::Epoch Rcu::epoch_c { 0 };
+Rcu::Epoch Rcu::epoch_q { 0 };
 
+Atomic<Rcu::Epoch, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST> Rcu::eqs { 0 };
+
+/*
+ * Invoke a bounded batch of callbacks whose grace period has completed
+ *
+ * Remaining callbacks are invoked by subsequent checks, so that a long list
+ * does not inflate the kernel latency of this CPU. A self-RKE triggers the next
+ * check, because an idle CPU would otherwise only check again on an unrelated
+ * interrupt. Hazard::RCU cannot be used, because it reports a quiescent state.
+ */
 void Rcu::handle_callbacks()
 {
-    for (Rcu_elem *e = done.head, *n; e; e = n) {
-        n = e->next;
+    Rcu_elem *e;
+
+    for (unsigned n { 0 }; n < batch && (e = done.dequeue()); n++)
         (e->func)(e);
-    }
 
-    done.clear();
+    if (EXPECT_FALSE (done.head))
+        Interrupt::send_cpu (Interrupt::Request::RKE, Cpu::id);
 }
 
 void Rcu::set_state (State s)
@@ -61,9 +75,107 @@ void Rcu::set_state (State s)
     if ((e ^ ~s) & State::FULL)
         return;
 
-    count = Cpu::count;
+    // Count all CPUs, plus one to keep the epoch from completing while crediting CPUs below
+    count = Cpu::count + 1;
 
     epoch++;
+
+    Epoch const g { epoch >> 2 };
+
+    cpu_t n { 1 };
+
+    // Credit CPUs in an extended quiescent state, which hold no references from before this epoch, unless they already accounted for it
+    for (cpu_t c { 0 }; c < Cpu::count; c++) {
+
+        auto const q { Kmem::loc_to_glob (c, &eqs) };
+
+        for (Epoch w { *q }; w & 1 && w >> 1 != g; )
+            if (q->compare_exchange_n (w, g << 1 | 1)) {
+                n++;
+                break;
+            }
+    }
+
+    // This CPU has not yet observed the new epoch, so it remains counted
+    count -= n;
+
+    if (EXPECT_FALSE (!complete (epoch, target)))
+        force();
+}
+
+/*
+ * Force all CPUs through a quiescent state in the current epoch
+ *
+ * The RKE IPI makes each CPU check the RCU state and pass through a quiescent
+ * state on its next kernel exit, instead of waiting for its next budget timeout.
+ */
+void Rcu::force()
+{
+    Interrupt::send_exc (Interrupt::Request::RKE);
+    Interrupt::send_cpu (Interrupt::Request::RKE, Cpu::id);
+}
+
+/*
+ * Expedite the next two grace periods, which covers all callbacks submitted so far
+ *
+ * This does not invoke any callbacks and can therefore be used with locks held,
+ * e.g., when memory is low or when teardown latency matters.
+ */
+void Rcu::expedite()
+{
+    Epoch const t { (epoch >> 2) + 2 };
+
+    // Only the CPU that raised the target sends IPIs, so that repeated calls do not flood the other CPUs
+    for (Epoch o { target }; static_cast<signed long>(t - o) > 0; )
+        if (target.compare_exchange_n (o, t)) {
+            force();
+            break;
+        }
+}
+
+/*
+ * Enter an extended quiescent state (idle or guest mode)
+ *
+ * Any epoch that starts while this CPU remains in the extended quiescent state
+ * is credited by the CPU that starts it, so this CPU need not pass through Rcu::quiet.
+ * An epoch that started before, but that this CPU has not yet observed, is
+ * quiesced right here. The EQS word records the epoch this CPU has accounted
+ * for, so that the CPU that starts that epoch does not credit it a second time.
+ */
+void Rcu::eqs_enter()
+{
+    assert (!(Cpu::hazard & Hazard::RCU));
+
+    for (;;) {
+
+        // This CPU has already accounted for the epoch it observed last
+        eqs = epoch_l << 1 | 1;
+
+        Epoch const g { epoch >> 2 };
+
+        if (EXPECT_TRUE (epoch_l == g))
+            return;
+
+        eqs_leave();
+
+        epoch_l = g;
+
+        if (epoch_q != g && !--count)
+            set_state (State::COMPLETED);
+    }
+}
+
+/*
+ * Leave the extended quiescent state and remember the epoch credited meanwhile
+ */
+void Rcu::eqs_leave()
+{
+    Epoch w { 0 }, n { 0 };
+
+    eqs.exchange (w, n);
+
+    if (w >> 1)
+        epoch_q = w >> 1;
 }
 
 /*
@@ -84,11 +196,15 @@ void Rcu::quiet()
  */
 void Rcu::check()
 {
+    eqs_exit();
+
     Epoch e { epoch }, g { e >> 2 };
 
     if (epoch_l != g) {
         epoch_l = g;
-        Cpu::hazard |= Hazard::RCU;
+
+        if (epoch_q != g)
+            Cpu::hazard |= Hazard::RCU;
     }
 
     if (curr.head && complete (e, epoch_c))
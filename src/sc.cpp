@@ -24,9 +24,24 @@
 #include "stc.hpp"
 #include "stdio.hpp"
 
-INIT_PRIORITY (PRIO_SLAB) Slab_cache Sc::cache { sizeof (Sc), Kobject::alignment };
+INIT_PRIORITY (PRIO_SLAB) Slab_cache Sc::cache { sizeof (Sc), Kobject::alignment_mp, 2 };
 
-Sc::Sc (Refptr<Ec> &e, cpu_t n, uint16_t b, uint8_t p, cos_t c) : Kobject { Kobject::Type::SC }, ec { std::move (e) }, budget { Stc::ms_to_ticks (b) }, cpu { n }, cos { c }, prio { p }
+Sc::Sc (Refptr<Pd> &o, Refptr<Ec> &e, cpu_t n, uint16_t b, uint8_t p, cos_t c) : Kobject { Kobject::Type::SC }, cpu { n }, cos { c }, prio { p }, ec { std::move (e) }, budget { Stc::ms_to_ticks (b) }, owner { std::move (o) }
 {
     trace (TRACE_CREATE, "SC:%p created (EC:%p CPU:%u Budget:%ums Prio:%u COS:%u)", static_cast<void *>(this), static_cast<void *>(ec), cpu, b, p, c);
 }
+
+/*
+ * Determine if the SC is still in use by the kernel without holding a reference
+ *
+ * An EC moves the SCs blocked on it into the scheduler with its lock held, so
+ * holding that lock covers the transit from the EC to the scheduler queues.
+ *
+ * @return      True if the SC is blocked on its EC, queued in a scheduler queue or current
+ */
+bool Sc::busy() const
+{
+    Lock_guard <Spinlock> guard { ec->lock };
+
+    return Scheduler::busy (this);
+}
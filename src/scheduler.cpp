@@ -34,7 +34,17 @@ INIT_PRIORITY (PRIO_LOCAL)  Scheduler::Release  Scheduler::release;
 
 Sc *Scheduler::current { nullptr };
 
-void Scheduler::Ready::enqueue (Sc *sc, uint64_t t)
+/*
+ * Enqueue SC into the ready queue
+ *
+ * With direct switch, an SC whose priority is at least that of the current
+ * SC is selected by the next schedule, ahead of the current SC.
+ *
+ * @param sc    SC to enqueue
+ * @param t     Current time
+ * @param d     True to request a direct switch to the SC
+ */
+void Scheduler::Ready::enqueue (Sc *sc, uint64_t t, bool d)
 {
     assert (sc->cpu == Cpu::id);
     assert (sc->prio < priorities);
@@ -44,31 +54,67 @@ void Scheduler::Ready::enqueue (Sc *sc, uint64_t t)
 
     queue[sc->prio].enqueue (sc, sc->left);
 
-    if (sc->prio > current->prio || (sc != current && sc->prio == current->prio && sc->left))
+    if (sc->prio > current->prio || (sc != current && sc->prio == current->prio && (sc->left || d)))
         Cpu::hazard |= Hazard::SCHED;
 
+    if (d && sc != current && sc->prio >= current->prio)
+        direct = sc;
+
     if (!sc->left)
         sc->left = sc->budget;
 
     sc->last = t;
 }
 
+/*
+ * Dequeue the next SC from the ready queue and make it current
+ *
+ * SCs whose last reference was dropped are removed from the ready queue instead,
+ * which leaves them to their pending destruction. The idle SC always remains.
+ *
+ * @param t     Current time
+ * @return      SC that is now current
+ */
 auto Scheduler::Ready::dequeue (uint64_t t)
 {
-    auto const sc { queue[prio_top].dequeue_head() };
+    Sc *sc;
 
-    assert (sc);
-    assert (sc->cpu == Cpu::id);
-    assert (sc->prio < priorities);
+    for (;;) {
 
-    while (queue[prio_top].empty() && prio_top)
-        prio_top--;
+        sc = direct;
+
+        direct = nullptr;
+
+        // Honor a direct switch unless a higher-priority SC became ready since
+        if (!sc || !sc->queued() || sc->prio != prio_top)
+            sc = queue[prio_top].peek_head();
+
+        assert (sc);
+        assert (sc->cpu == Cpu::id);
+        assert (sc->prio < priorities);
+
+        if (EXPECT_TRUE (!sc->unreferenced()))
+            break;
+
+        queue[prio_top].dequeue (sc);
+
+        while (queue[prio_top].empty() && prio_top)
+            prio_top--;
+    }
 
     if (EXPECT_TRUE (sc->ec != current->ec))
         sc->ec->adjust_offset_ticks (t - sc->last);
 
     sc->last = t;
 
+    // Make the SC current before dequeuing it, so that busy() always finds it queued or current
+    current = sc;
+
+    queue[prio_top].dequeue (sc);
+
+    while (queue[prio_top].empty() && prio_top)
+        prio_top--;
+
     return sc;
 }
 
@@ -87,26 +133,69 @@ void Scheduler::Release::enqueue (Sc *sc)
         Interrupt::send_cpu (Interrupt::Request::RRQ, sc->cpu);
 }
 
-auto Scheduler::Release::dequeue()
+/*
+ * Move all SCs from the release queue into the ready queue
+ *
+ * The lock is held until the SCs are in the ready queue, so that busy() always
+ * finds them queued.
+ *
+ * @param r     Ready queue
+ * @param t     Current time
+ */
+void Scheduler::Release::requeue (Ready &r, uint64_t t)
+{
+    Lock_guard <Spinlock> guard { lock };
+
+    for (Sc *sc; (sc = queue.dequeue_head()); r.enqueue (sc, t)) ;
+}
+
+/*
+ * Determine if an SC is queued in a scheduler queue of its CPU or current on it
+ *
+ * @param sc    SC on the CPU of this release queue
+ * @return      True if the SC is queued or current, false otherwise
+ */
+bool Scheduler::Release::busy (Sc const *sc)
 {
     Lock_guard <Spinlock> guard { lock };
 
-    return queue.dequeue_head();
+    return sc->queued() || *Kmem::loc_to_glob (sc->cpu, &current) == sc;
 }
 
-void Scheduler::unblock (Sc *sc)
+/*
+ * Unblock SC
+ *
+ * A direct switch is only possible if the SC belongs to the current CPU.
+ *
+ * @param sc    SC to unblock
+ * @param d     True to request a direct switch to the SC
+ */
+void Scheduler::unblock (Sc *sc, bool d)
 {
     if (Cpu::id == sc->cpu)
-        ready.enqueue (sc, Timer::time());
+        ready.enqueue (sc, Timer::time(), d);
     else
         release.enqueue (sc);
 }
 
 void Scheduler::requeue()
 {
-    auto const t { Timer::time() };
+    release.requeue (ready, Timer::time());
+}
 
-    for (Sc *sc; (sc = release.dequeue()); ready.enqueue (sc, t)) ;
+/*
+ * Determine if an SC is still in use by the scheduler without holding a reference
+ *
+ * An SC can only be current on its own CPU. Moves between the queues of that CPU
+ * either hold the lock of the release queue or keep the SC current, so the SC
+ * cannot be observed in transit.
+ *
+ * @param sc    SC
+ * @return      True if the SC is queued or current, false otherwise
+ */
+bool Scheduler::busy (Sc const *sc)
+{
+    return Kmem::loc_to_glob (sc->cpu, &release)->busy (sc);
 }
 
 void Scheduler::schedule (bool blocked)
@@ -24,6 +24,29 @@
 #include "buddy.hpp"
 #include "lock_guard.hpp"
 #include "slab.hpp"
+#include "stdio.hpp"
+
+Slab_cache *Slab_cache::list;
+
+/*
+ * Shared size classes
+ *
+ * Up to 1024 bytes, size classes are powers of two. Beyond that, they are the
+ * largest multiples of 64 that still fit 3, 2 and 1 buffer(s) into a slab.
+ * All size classes from 64 bytes upward are therefore 64-byte aligned.
+ */
+INIT_PRIORITY (PRIO_SLAB) Slab_cache Slab_cache::sized[]
+{
+    {   32, 32, 1 },
+    {   64, 64, 1 },
+    {  128, 64, 1 },
+    {  256, 64, 1 },
+    {  512, 64, 1 },
+    { 1024, 64, 1 },
+    { 1344, 64, 1 },
+    { 1984, 64, 1 },
+    { 4032, 64, 1 },
+};
 
 struct Slab_cache::Slab
 {
@@ -96,17 +119,20 @@ struct Slab_cache::Slab
     Metadata    meta;
     uint8_t     data[PAGE_SIZE (0) - sizeof (meta)];
 
+    static_assert (sizeof (Metadata) <= 64, "Largest size class does not fit into a slab");
+
     /*
      * Slab Constructor
      *
      * @param c Slab cache to which this slab belongs
+     * @param o Colour offset of the first buffer
      */
     ALWAYS_INLINE
-    Slab (Slab_cache *c) : meta (c)
+    Slab (Slab_cache *c, unsigned o) : meta (c)
     {
         expose (this);
 
-        auto const s = data + sizeof (data);
+        auto const s = data + sizeof (data) - o;
 
         // Free all buffers in the slab
         for (auto i = c->bps; i; i--)
@@ -141,6 +167,7 @@ struct Slab_cache::Slab
  *
  * @param s Required element size
  * @param a Required element alignment (must be a power of 2)
+ * @param m Maximum number of empty slabs to retain
  *
  * Slab Linkage Example (P:partial precede F:full)
  *
@@ -152,52 +179,101 @@ struct Slab_cache::Slab
  *  head &&  curr => slab cache contains some P-Slabs => buffer in curr available
  * !head && !curr => slab cache contains no slabs => initial state
  * !head &&  curr => illegal
+ *
+ * Empty slabs are not part of the slab list. Up to lim empty slabs are
+ * retained on a separate spare list, so that allocation patterns that
+ * oscillate around a slab boundary do not thrash the buddy allocator.
+ *
+ * Slab Colouring: The unused space of a slab shifts the buffers of
+ * consecutive slabs by different multiples of a cache line, so that
+ * objects at the same index in different slabs map to different sets.
  */
-Slab_cache::Slab_cache (size_t s, size_t a) : bsz (static_cast<uint16_t>(align_up (max (s, sizeof (Slab::Buffer)), max (a, alignof (Slab::Buffer))))),
-                                              bps ((PAGE_SIZE (0) - sizeof (Slab::Metadata)) / bsz) {}
+Slab_cache::Slab_cache (size_t s, size_t a, unsigned m) : bsz (static_cast<uint16_t>(align_up (max (s, sizeof (Slab::Buffer)), max (a, alignof (Slab::Buffer))))),
+                                                          bps ((PAGE_SIZE (0) - sizeof (Slab::Metadata)) / bsz),
+                                                          lim (static_cast<uint16_t>(m)),
+                                                          cst (static_cast<uint16_t>(align_up (max (a, size_t { 64 }), a)))
+{
+    // Register caches that retain empty slabs for reclaim (caches are constructed during single-threaded init)
+    if (lim) {
+        link = list;
+        list = this;
+    }
+}
 
 /*
- * Allocate an element in this slab cache
+ * Link an empty slab as head and curr of this slab cache
  *
- * @return  Pointer to the element (success) or nullptr (failure)
+ * The slab is taken from the spare list if possible, otherwise allocated.
+ *
+ * @return  true if successful, false otherwise
  */
-void *Slab_cache::alloc()
+bool Slab_cache::grow()
 {
-    Lock_guard <Spinlock> guard { lock };
+    auto slab { spare };
 
-    // Cache contains no slabs or only full slabs
-    if (EXPECT_FALSE (!curr)) {
+    if (slab) {
+        spare = slab->meta.next;
+        cnt--;
+        assert (slab->meta.empty());
 
-        // Allocate a new slab
-        auto const slab { new Slab (this) };
+    // Allocate a new slab
+    } else if (EXPECT_FALSE (!(slab = new Slab (this, col))))
+        return false;
 
-        // Allocation failed
-        if (EXPECT_FALSE (!slab))
-            return nullptr;
+    // Advance to the next colour that fits into the unused space of a slab
+    else if ((col = static_cast<uint16_t>(col + cst)) > sizeof (Slab::data) - bps * bsz)
+        col = 0;
 
-        // Link slab as head and curr (with no predecessor)
-        slab->meta.next = head;
+    // Link slab as head and curr (with no predecessor)
+    slab->meta.prev = nullptr;
+    slab->meta.next = head;
 
-        if (head)
-            head->meta.prev = slab;
+    if (head)
+        head->meta.prev = slab;
 
-        head = curr = slab;
-    }
+    head = curr = slab;
+
+    return true;
+}
+
+/*
+ * Allocate an element in this slab cache
+ *
+ * If no slab can be allocated, the empty slabs of all slab caches are
+ * reclaimed and the allocation is retried once.
+ *
+ * @return  Pointer to the element (success) or nullptr (failure)
+ */
+void *Slab_cache::alloc()
+{
+    for (auto retry { true };; retry = false) {
+
+        {   Lock_guard <Spinlock> guard { lock };
+
+            // Cache contains no slabs or only full slabs
+            if (EXPECT_TRUE (curr || grow())) {
 
-    // The current slab must be either empty or partial
-    assert (!curr->meta.full());
+                // The current slab must be either empty or partial
+                assert (!curr->meta.full());
 
-    // If we have a successor slab, it must be full
-    assert (!curr->meta.next || curr->meta.next->meta.full());
+                // If we have a successor slab, it must be full
+                assert (!curr->meta.next || curr->meta.next->meta.full());
 
-    // Allocate element in current slab
-    auto p = curr->meta.alloc();
+                // Allocate element in current slab
+                auto p = curr->meta.alloc();
 
-    // If the current slab is now full, make its predecessor current
-    if (EXPECT_FALSE (curr->meta.full()))
-        curr = curr->meta.prev;
+                // If the current slab is now full, make its predecessor current
+                if (EXPECT_FALSE (curr->meta.full()))
+                    curr = curr->meta.prev;
 
-    return p;
+                return p;
+            }
+        }
+
+        // Allocation failed, even after reclaiming memory
+        if (!retry || !reclaim_all())
+            return nullptr;
+    }
 }
 
 /*
@@ -235,8 +311,16 @@ void Slab_cache::free (void *p)
         if (slab->meta.next)
             slab->meta.next->meta.prev = slab->meta.prev;
 
+        // Retain slab on the spare list
+        if (cnt < lim) {
+            slab->meta.prev = nullptr;
+            slab->meta.next = spare;
+            spare = slab;
+            cnt++;
+
         // Deallocate slab
-        delete slab;
+        } else
+            delete slab;
 
     // Slab Transition Full => Partial
     } else if (EXPECT_FALSE (was_full)) {
@@ -263,3 +347,67 @@ void Slab_cache::free (void *p)
         curr = slab;
     }
 }
+
+/*
+ * Release all empty slabs of this slab cache
+ *
+ * @return  Number of slabs released
+ */
+unsigned Slab_cache::reclaim()
+{
+    Slab *slab;
+
+    {   Lock_guard <Spinlock> guard { lock };
+
+        slab = spare;
+        spare = nullptr;
+        cnt = 0;
+    }
+
+    unsigned n { 0 };
+
+    for (Slab *next; slab; slab = next, n++) {
+        next = slab->meta.next;
+        delete slab;
+    }
+
+    return n;
+}
+
+/*
+ * Release all empty slabs of all slab caches
+ *
+ * Must not be called while holding the lock of any slab cache.
+ *
+ * @return  Number of slabs released
+ */
+unsigned Slab_cache::reclaim_all()
+{
+    unsigned n { 0 };
+
+    for (auto c { list }; c; c = c->link)
+        n += c->reclaim();
+
+    return n;
+}
+
+/*
+ * Determine the smallest shared size class for the specified size
+ *
+ * @param s Required element size
+ * @return  Shared slab cache for that size class
+ */
+Slab_cache &Slab_cache::size_class (size_t s)
+{
+    auto const e { sized + sizeof (sized) / sizeof (*sized) };
+
+    auto c { sized };
+
+    while (c < e && c->size() < s)
+        c++;
+
+    if (EXPECT_FALSE (c == e))
+        panic ("No shared size class for %lu bytes", s);
+
+    return *c;
+}
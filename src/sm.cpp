@@ -22,9 +22,257 @@
 #include "sm.hpp"
 #include "stdio.hpp"
 
-INIT_PRIORITY (PRIO_SLAB) Slab_cache Sm::cache { sizeof (Sm), Kobject::alignment };
+INIT_PRIORITY (PRIO_SLAB) Slab_cache Sm::cache { sizeof (Sm), Kobject::alignment_mp, 2 };
 
-Sm::Sm (uint64_t c, unsigned i) : Kobject { Kobject::Type::SM }, counter { c }, id { i }
+Sm::Sm (Refptr<Pd> &o, uint64_t c, unsigned i, bool g, bool p) : Kobject { Kobject::Type::SM }, state { c | g * indirect }, id { i }, grp { g }, pri { p }, owner { std::move (o) }
 {
-    trace (TRACE_CREATE, "SM:%p created (CNT:%lu)", static_cast<void *>(this), c);
+    trace (TRACE_CREATE, "SM:%p created (CNT:%lu%s%s)", static_cast<void *>(this), c, g ? " GRP" : "", p ? " PRIO" : "");
+}
+
+/*
+ * Down operation (slow path)
+ *
+ * @param self  Calling EC
+ * @param zero  True to consume the entire counter, false to decrement it
+ * @param t     Absolute timeout (or 0 for no timeout)
+ * @return      True if successful, false if the semaphore is bound to a group
+ */
+bool Sm::dn_slow (Ec *const self, bool zero, uint64_t t)
+{
+    {   Lock_guard <Spinlock> guard { lock };
+
+        // A concurrent fast-path up() can still increment the counter until WAITERS is set
+        for (uint64_t o { state };;) {
+
+            // The semaphore was bound to a group, which now owns its counter
+            if (EXPECT_FALSE (o & indirect))
+                return false;
+
+            if (o & counter_max) {
+                if (state.compare_exchange_n (o, zero ? 0 : o - 1))
+                    return true;
+                continue;
+            }
+
+            if (state.compare_exchange_n (o, o | waiters))
+                break;
+        }
+
+        // The EC can no longer be activated
+        self->block();
+
+        enqueue_waiter (self);
+    }
+
+    // At this point remote cores can unblock the EC
+
+    if (self->block_sc()) {
+
+        if (t)
+            self->set_timeout (t, this);
+
+        Scheduler::schedule (true);
+    }
+
+    return true;
+}
+
+/*
+ * Up operation (slow path)
+ *
+ * @param d     True to switch directly to the woken EC if its priority permits
+ * @return      True if successful, false if the counter would overflow
+ */
+bool Sm::up_slow (bool d)
+{
+    Ec *ec;
+
+    // Semaphores bound to a group are signaled through their group
+    if (EXPECT_FALSE (state.load (__ATOMIC_ACQUIRE) & indirect))
+        return group->signal (this, d);
+
+    {   Lock_guard <Spinlock> guard { lock };
+
+        // The semaphore was bound to a group (under the lock) after the check above
+        if (EXPECT_FALSE (state & indirect))
+            ec = nullptr;
+
+        // WAITERS was cleared before we acquired the lock
+        else if (!(ec = dequeue_head())) {
+
+            for (uint64_t o { state };;) {
+
+                assert (!(o & waiters));
+
+                if ((o & counter_max) == counter_max)
+                    return false;
+
+                if (state.compare_exchange_n (o, o + 1))
+                    return true;
+            }
+        }
+
+        if (ec) {
+
+            if (empty())
+                state &= ~waiters;
+
+            // The EC can now be activated again
+            ec->unblock (Ec::sys_finish<Status::SUCCESS, true>, false);
+        }
+    }
+
+    if (EXPECT_FALSE (!ec))
+        return group->signal (this, d);
+
+    ec->unblock_sc (d);
+
+    return true;
+}
+
+/*
+ * Bind this semaphore to a group semaphore
+ *
+ * After binding, up operations on this semaphore wake an EC waiting on the
+ * group and down operations on the group report the tag of this semaphore.
+ *
+ * @param g     Group semaphore
+ * @param t     Tag that identifies this semaphore within the group
+ * @return      SUCCESS (successful) or BAD_PAR (bad parameter) or ABORTED (group is being destroyed)
+ */
+Status Sm::bind (Sm *g, uintptr_t t)
+{
+    if (EXPECT_FALSE (!g->is_group() || is_group()))
+        return Status::BAD_PAR;
+
+    if (EXPECT_FALSE (!g->try_inc()))
+        return Status::ABORTED;
+
+    Ec *ec { nullptr };
+
+    {   Lock_guard <Spinlock> guard_m { lock };
+        Lock_guard <Spinlock> guard_g { g->lock };
+
+        // The semaphore must not be bound already and must not have waiters
+        if (EXPECT_FALSE (group || !empty())) {
+            g->ref_dec();
+            return Status::BAD_PAR;
+        }
+
+        tag   = t;
+        group = g;
+
+        // Disable the fast paths, which stops concurrent modifications of the counter
+        auto const o { state.fetch_or (indirect) };
+
+        // Signals that arrived before binding are pending in the group
+        if (o & counter_max) {
+
+            g->pending.enqueue_tail (this);
+
+            if ((ec = g->dequeue_head()) && g->empty())
+                g->state &= ~waiters;
+
+            if (ec)
+                ec->unblock (Ec::sys_ctrl_sm_retry, false);
+        }
+    }
+
+    if (ec)
+        ec->unblock_sc();
+
+    return Status::SUCCESS;
+}
+
+/*
+ * Signal a member of this group
+ *
+ * @param sm    Member semaphore
+ * @param d     True to switch directly to the woken EC if its priority permits
+ * @return      True if successful, false if the member counter would overflow
+ */
+bool Sm::signal (Sm *sm, bool d)
+{
+    Ec *ec;
+
+    {   Lock_guard <Spinlock> guard { lock };
+
+        if (EXPECT_FALSE ((sm->state & counter_max) == counter_max))
+            return false;
+
+        sm->state++;
+
+        if (!sm->queued())
+            pending.enqueue_tail (sm);
+
+        if (!(ec = dequeue_head()))
+            return true;
+
+        if (empty())
+            state &= ~waiters;
+
+        // The EC can now be activated again and will retry its down operation
+        ec->unblock (Ec::sys_ctrl_sm_retry, false);
+    }
+
+    ec->unblock_sc (d);
+
+    return true;
+}
+
+/*
+ * Down operation on a group semaphore
+ *
+ * @param self  Calling EC
+ * @param zero  True to consume the entire member counter, false to decrement it
+ * @param t     Absolute timeout (or 0 for no timeout)
+ * @return      Member semaphore whose counter was consumed (blocks otherwise)
+ */
+Sm *Sm::dn_group (Ec *const self, bool zero, uint64_t t)
+{
+    assert (is_group());
+
+    {   Lock_guard <Spinlock> guard { lock };
+
+        auto const sm { static_cast<Sm *>(pending.dequeue_head()) };
+
+        if (sm) {
+
+            auto const o { sm->state & counter_max };
+
+            assert (o);
+
+            sm->state -= zero ? o : 1;
+
+            if (!zero && o > 1)
+                pending.enqueue_tail (sm);
+
+            // Keep the member until the EC retires it with its next down on a group
+            assert (!self->consumed);
+            self->consumed = sm;
+            sm->refs++;
+
+            return sm;
+        }
+
+        state |= waiters;
+
+        // The EC can no longer be activated
+        self->block();
+
+        enqueue_waiter (self);
+    }
+
+    // At this point remote cores can unblock the EC
+
+    if (self->block_sc()) {
+
+        if (t)
+            self->set_timeout (t, this);
+
+        Scheduler::schedule (true);
+    }
+
+    // The EC was unblocked before its SC blocked and retries its down operation
+    Ec::sys_ctrl_sm_retry (self);
 }
@@ -19,6 +19,7 @@
  * GNU General Public License version 2 for more details.
  */
 
+#include "ptab_cache.hpp"
 #include "space_dma.hpp"
 #include "space_gst.hpp"
 #include "space_hst.hpp"
@@ -32,38 +33,75 @@ Status Space_mem<T>::delegate (Space_hst const *hst, unsigned long const ssb, un
         return Status::BAD_PAR;
 
     unsigned o;
+    Hpt::OAddr p;
+    Memattr a;
 
-    auto sts { Status::SUCCESS };
-
-    for (auto src { ssb }, dst { dsb }; src < sse; src += BITN (o), dst += BITN (o)) {
-
-        uintptr_t s { src << PAGE_BITS };
-        uintptr_t d { dst << PAGE_BITS };
-        Hpt::OAddr p;
-        Memattr a;
-
-        auto pm { Paging::Permissions (hst->lookup (s, p, o, a) & (Paging::K | Paging::U | pmm)) };
+    // Look up the source chunk at the specified selector and return its permissions, physical base address and memory attributes
+    auto const probe { [&] (unsigned long src)
+    {
+        auto pm { Paging::Permissions (hst->lookup (src << PAGE_BITS, p, o, a) & (Paging::K | Paging::U | pmm)) };
 
         // Kernel memory cannot be delegated
         if (pm & Paging::K)
             pm = Paging::NONE;
 
         // Memory attributes are inherited for virt/virt delegations
-        if (hst != &Space_hst::nova)
-            ma = a;
+        if (hst == &Space_hst::nova || !pm)
+            a = ma;
 
         o = min (o, ord);
+        p = pm ? p & ~Hpt::offs_mask (o) : 0;
+
+        return pm;
+    }};
+
+    auto sts { Status::SUCCESS };
+
+    // Set if the delegation removed or downgraded a present mapping
+    bool inv { false };
+
+    auto pm { probe (ssb) };
+
+    for (auto src { ssb }; src < sse;) {
 
-        d &= ~Hpt::offs_mask (o);
-        p &= ~Hpt::offs_mask (o);
+        auto const run_src { src };
+        auto const run_pm  { pm };
+        auto const run_phys { p };
+        auto const run_ma  { a };
 
-        if ((sts = static_cast<T *>(this)->update (d, p, o, pm, ma)) != Status::SUCCESS)
+        // Coalesce subsequent source chunks that continue the run physically contiguous with the same permissions and memory attributes
+        for (src += BITN (o); src < sse; src += BITN (o))
+            if ((pm = probe (src)) != run_pm || !(a == run_ma) || p != (run_pm ? run_phys + ((src - run_src) << PAGE_BITS) : 0))
+                break;
+
+        uintptr_t d { (dsb + run_src - ssb) << PAGE_BITS };
+        uintptr_t e { (dsb + src     - ssb) << PAGE_BITS };
+
+        // Update the destination for the entire run, using the largest pages that the alignment permits
+        for (auto phys { run_phys }; d < e && sts == Status::SUCCESS;) {
+
+            auto const ro { static_cast<unsigned>(max_order (d | phys, e - d)) };
+
+            sts = static_cast<T *>(this)->update (d, phys, ro - PAGE_BITS, run_pm, run_ma, &inv);
+
+            d += BITN (ro);
+
+            if (run_pm)
+                phys += BITN (ro);
+        }
+
+        if (sts != Status::SUCCESS)
             break;
     }
 
-    static_cast<T *>(this)->sync();
+    // Stale translations that only lack permissions cannot be harmful, so skip the invalidation if the delegation only added mappings or permissions
+    if (inv) {
 
-    Buddy::free_wait();
+        static_cast<T *>(this)->sync();
+
+        Buddy::free_wait();
+        Ptab_cache::free_wait();
+    }
 
     return sts;
 }
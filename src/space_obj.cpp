@@ -53,14 +53,74 @@ INIT_PRIORITY (PRIO_SPACE_OBJ) ALIGNED (Kobject::alignment) Space_obj Space_obj:
  *
  *      Level 3         Level 2             Level 1             Level 0
  *      Captable *      Captable *[n]       Captable *[n]       Capability[n]
+ *
+ * Because Captables are page-aligned, an entry that points to a leaf Captable
+ * stores its occupancy in the low bits: the number of non-null capabilities plus
+ * the number of walks that have reserved a slot in it for a new capability.
+ * A leaf Captable whose occupancy drops to zero is unlinked and freed after an
+ * RCU grace period, because concurrent lookups may still be reading it.
  */
 
 struct Space_obj::Captable
 {
     static constexpr auto entries { BIT (bpl) };
 
+    // Occupancy bits in an entry that points to a leaf Captable (each CPU holds at most one reservation)
+    static constexpr uintptr_t omask { PAGE_SIZE (0) - 1 };
+
     Atomic<Captable *> slot[entries] { nullptr };
 
+    /*
+     * RCU element that frees a drained leaf Captable after a grace period
+     */
+    class Drained final : public Rcu_elem
+    {
+        private:
+            Captable * const tbl;
+
+            static void free (Rcu_elem *e)
+            {
+                auto const d { static_cast<Drained *>(e) };
+
+                delete d->tbl;
+
+                cache.free (d);
+            }
+
+        public:
+            static Slab_cache cache;
+
+            explicit Drained (Captable *t) : Rcu_elem { free }, tbl { t } {}
+
+            [[nodiscard]] static void *operator new (size_t) noexcept { return cache.alloc(); }
+    };
+
+    /*
+     * Determine the Captable that an entry points to
+     *
+     * @param e     Entry value
+     * @return      Pointer to the Captable without occupancy bits
+     */
+    static Captable *table (Captable *e) { return reinterpret_cast<Captable *>(reinterpret_cast<uintptr_t>(e) & ~omask); }
+
+    /*
+     * Reserve a slot in the leaf Captable that an entry points to
+     *
+     * @param ptr   Pointer to the entry
+     * @param tbl   Leaf Captable the entry is expected to point to
+     * @return      True if successful, false if the entry no longer points to that Captable
+     */
+    static bool reserve (Atomic<Captable *> *ptr, Captable *tbl)
+    {
+        auto const e { reinterpret_cast<Atomic<uintptr_t> *>(ptr) };
+
+        for (uintptr_t v { *e }; (v & ~omask) == reinterpret_cast<uintptr_t>(tbl); )
+            if (e->compare_exchange_n (v, v + 1))
+                return true;
+
+        return false;
+    }
+
     /*
      * Allocate a Captable
      *
@@ -83,18 +143,25 @@ struct Space_obj::Captable
     }
 
     /*
-     * Deallocate a Captable subtree
+     * Deallocate a Captable subtree and release the references held by its capabilities
      *
      * @param l     Subtree level
+     * @param q     Quota to uncharge (or nullptr for none)
      */
-    inline void deallocate (unsigned l)
+    inline void deallocate (unsigned l, Quota *q)
     {
-        if (l)
-            for (unsigned i { 0 }; i < entries; i++)
-                if (slot[i])
-                    slot[i]->deallocate (l - 1);
+        for (unsigned i { 0 }; i < entries; i++)
+            if (slot[i]) {
+                if (l)
+                    table (slot[i])->deallocate (l - 1, q);
+                else
+                    Capability (reinterpret_cast<uintptr_t>(static_cast<Captable *>(slot[i]))).release();
+            }
 
         delete this;
+
+        if (q)
+            q->uncharge (sizeof (Captable));
     }
 };
 
@@ -104,17 +171,24 @@ struct Space_obj::Captable
 Space_obj::~Space_obj()
 {
     if (root)
-        root->deallocate (lev - 1);
+        Captable::table (root)->deallocate (lev - 1, get_quota());
 }
 
+INIT_PRIORITY (PRIO_SLAB) Slab_cache Space_obj::Captable::Drained::cache { sizeof (Captable::Drained), alignof (Captable::Drained) };
+
 /*
  * Walk capability tables and return pointer to the capability slot for the specified selector
  *
+ * When making entries, the walk reserves a slot in the leaf Captable, which the
+ * caller must account for with adjust() after updating the capability slot.
+ *
  * @param sel   Selector whose slot is being looked up
  * @param e     True if making entries, false if making holes
+ * @param ent   Returns pointer to the entry that points to the leaf Captable
+ * @param skp   Returns the number of selectors from sel to the end of a skippable hole (if not nullptr)
  * @return      Pointer to the capability slot (if exists) or ~0 (skippable hole) or nullptr (allocation failure)
  */
-Atomic<Capability> *Space_obj::walk (unsigned long sel, bool e)
+Atomic<Capability> *Space_obj::walk (unsigned long sel, bool e, Atomic<Captable *> *&ent, unsigned long *skp)
 {
     auto l { lev }; Captable *cte;
 
@@ -125,34 +199,146 @@ Atomic<Capability> *Space_obj::walk (unsigned long sel, bool e)
         if (!l)
             return reinterpret_cast<Atomic<Capability> *>(ptr);
 
-        // If the capability table entry is empty, we may need a new capability table for the next level
-        if (EXPECT_FALSE (!(cte = *ptr))) {
+        ent = ptr;
+
+        // Get the capability table for the next level and, if making entries in a leaf capability table, reserve a slot in it
+        while (!(cte = Captable::table (*ptr)) || (l == 1 && e && !Captable::reserve (ptr, cte))) {
+
+            // Retry if the leaf capability table drained and was unlinked meanwhile
+            if (cte)
+                continue;
 
-            // Terminate the walk for a skippable hole
-            if (!e)
+            // Terminate the walk for a skippable hole, which spans the entire subtree below this level
+            if (!e) {
+                if (skp)
+                    *skp = span (sel, l);
                 return reinterpret_cast<Atomic<Capability> *>(~0UL);
+            }
+
+            auto const q { get_quota() };
+
+            // Terminate the walk if the quota is exhausted
+            if (EXPECT_FALSE (q && !q->charge (sizeof (Captable))))
+                return nullptr;
 
             // Allocate a new capability table
             auto tbl { new Captable };
 
             // Terminate the walk if allocation failed
-            if (EXPECT_FALSE (!tbl))
+            if (EXPECT_FALSE (!tbl)) {
+                if (q)
+                    q->uncharge (sizeof (Captable));
                 return nullptr;
+            }
+
+            // A new leaf capability table starts out with our reservation
+            Captable *val { reinterpret_cast<Captable *>(reinterpret_cast<uintptr_t>(tbl) + (l == 1)) }, *old { nullptr };
 
             // Try to install our new capability table into the supposedly empty slot
             // * Success: continue with our new capability table
-            // * Failure: someone beat us to it; deallocate our new capability table and continue with theirs
-            // Note: A compare_exchange failure changes cte from nullptr to the existing value at ptr
-            if (EXPECT_TRUE (ptr->compare_exchange (cte, tbl)))
+            // * Failure: someone beat us to it; deallocate our new capability table and retry with theirs
+            if (EXPECT_TRUE (ptr->compare_exchange (old, val))) {
                 cte = tbl;
-            else
-                delete tbl;
+                break;
+            }
+
+            delete tbl;
+            if (q)
+                q->uncharge (sizeof (Captable));
         }
 
         // Proceed with the capability table for the next level
     }
 }
 
+/*
+ * Adjust the occupancy of a leaf Captable and free it once it drains
+ *
+ * @param ent   Pointer to the entry that points to the leaf Captable
+ * @param d     Occupancy delta
+ */
+void Space_obj::adjust (Atomic<Captable *> *ent, int d)
+{
+    if (!d)
+        return;
+
+    auto const e { reinterpret_cast<Atomic<uintptr_t> *>(ent) };
+
+    uintptr_t v { *e += static_cast<uintptr_t>(d) };
+
+    // Done unless the leaf capability table drained
+    if (d > 0 || v & Captable::omask)
+        return;
+
+    auto const r { new Captable::Drained { reinterpret_cast<Captable *>(v) } };
+
+    // Keep the leaf capability table if it cannot be freed or if a walk reserved a slot in it meanwhile
+    if (EXPECT_FALSE (!r || !e->compare_exchange_n (v, 0))) {
+        if (r)
+            Captable::Drained::cache.free (r);
+        return;
+    }
+
+    if (auto const q { get_quota() }; q)
+        q->uncharge (sizeof (Captable));
+
+    Rcu::submit (r);
+}
+
+/*
+ * Find the capability slot for the specified selector without allocating capability tables
+ *
+ * @param sel   Selector whose slot is being looked up
+ * @param skp   Returns the number of selectors from sel to the end of the missing subtree (if not nullptr)
+ * @return      Pointer to the capability slot (if the leaf table exists) or nullptr (otherwise)
+ */
+Atomic<Capability> *Space_obj::find (unsigned long sel, unsigned long *skp) const
+{
+    auto l { lev }; Captable *cte;
+
+    // Walk down the capability tables from the root, computing the slot index at each level
+    for (auto ptr { &root };; ptr = &cte->slot[(sel >> --l * bpl) % Captable::entries]) {
+
+        // Return pointer to the capability slot upon reaching the leaf level
+        if (!l)
+            return reinterpret_cast<Atomic<Capability> *>(const_cast<Atomic<Captable *> *>(ptr));
+
+        // Terminate the walk if the next level does not exist, which leaves the entire subtree below this level empty
+        if (!(cte = Captable::table (*ptr))) {
+            if (skp)
+                *skp = span (sel, l);
+            return nullptr;
+        }
+    }
+}
+
+/*
+ * Replace the capability in the specified slot
+ *
+ * @param ptr   Pointer to the capability slot
+ * @param cap   New capability for that slot
+ * @return      Occupancy delta of the leaf Captable (-1, 0, +1)
+ */
+int Space_obj::replace (Atomic<Capability> *ptr, Capability cap)
+{
+    Capability old;
+
+    // Try to acquire a reference on the capability object
+    auto const a { cap.acquire() };
+
+    if (a)
+        ptr->exchange (old, cap);   // success: replace with capability
+    else
+        ptr->exchange (old, old);   // failure: replace with null capability
+
+    auto const o { !!old.obj() };
+
+    // Release reference on the replaced capability object
+    old.release();
+
+    return a - o;
+}
+
 /*
  * Lookup OBJ capability for the specified selector
  *
@@ -166,9 +352,13 @@ Capability Space_obj::lookup (unsigned long sel) const
     // Walk down the capability tables from the root, computing the slot index at each level
     for (auto ptr { &root };; ptr = &cte->slot[(sel >> --l * bpl) % Captable::entries]) {
 
-        // Return capability upon reaching the last existing or leaf level
-        if (!(cte = *ptr) || !l)
-            return Capability (reinterpret_cast<uintptr_t>(cte));
+        // Return capability upon reaching the leaf level
+        if (!l)
+            return Capability (reinterpret_cast<uintptr_t>(static_cast<Captable *>(*ptr)));
+
+        // Return null capability upon reaching the last existing level
+        if (!(cte = Captable::table (*ptr)))
+            return Capability();
     }
 }
 
@@ -181,8 +371,11 @@ Capability Space_obj::lookup (unsigned long sel) const
  */
 Status Space_obj::update (unsigned long sel, Capability cap)
 {
+    Atomic<Captable *> *ent;
+
     // Get capability slot pointer
-    auto const ptr { walk (sel, cap.prm()) };
+    auto const e { !!cap.prm() };
+    auto const ptr { walk (sel, e, ent) };
 
     // Allocation failure
     if (EXPECT_FALSE (!ptr))
@@ -192,16 +385,8 @@ Status Space_obj::update (unsigned long sel, Capability cap)
     if (ptr == reinterpret_cast<Atomic<Capability> *>(~0UL))
         return Status::SUCCESS;
 
-    Capability old;
-
-    // Try to acquire a reference on the capability object
-    if (cap.acquire())
-        ptr->exchange (old, cap);   // success: replace with capability
-    else
-        ptr->exchange (old, old);   // failure: replace with null capability
-
-    // Release reference on the replaced capability object
-    old.release();
+    // Account for the capability change and drop our reservation
+    adjust (ent, replace (ptr, cap) - e);
 
     return Status::SUCCESS;
 }
@@ -215,8 +400,10 @@ Status Space_obj::update (unsigned long sel, Capability cap)
  */
 Status Space_obj::insert (unsigned long sel, Capability cap)
 {
+    Atomic<Captable *> *ent;
+
     // Get capability slot pointer. Allocate based on assumption that cap is not a null capability
-    auto const ptr { walk (sel, true) };
+    auto const ptr { walk (sel, true, ent) };
 
     // No slot, return error because we wanted to allocate
     if (EXPECT_FALSE (!ptr))
@@ -228,7 +415,7 @@ Status Space_obj::insert (unsigned long sel, Capability cap)
     // Acquire a reference on the capability object
     cap.publish();
 
-    // Try to install the capability
+    // Try to install the capability, which turns our reservation into occupancy
     Capability old;
     if (EXPECT_TRUE (ptr->compare_exchange (old, cap)))
         return Status::SUCCESS;
@@ -236,6 +423,9 @@ Status Space_obj::insert (unsigned long sel, Capability cap)
     // Release reference on the capability object
     cap.retract();
 
+    // Drop our reservation
+    adjust (ent, -1);
+
     return Status::BAD_CAP;
 }
 
@@ -256,18 +446,73 @@ Status Space_obj::delegate (Space_obj const *obj, unsigned long const ssb, unsig
     if (EXPECT_FALSE (sse > selectors || dse > selectors))
         return Status::BAD_PAR;
 
-    auto sts { Status::SUCCESS };
+    constexpr unsigned long n { Captable::entries };
+
+    // Process runs of selectors that lie within one source and one destination leaf table
+    for (auto src { ssb }, dst { dsb }; src < sse; ) {
+
+        auto cnt { min (sse - src, min (n - src % n, n - dst % n)) };
+
+        // Number of selectors to the end of a missing source subtree and of a destination hole
+        unsigned long ssk, dsk;
+
+        // Source slots for this run (or nullptr if the source leaf table does not exist)
+        auto const s { obj->find (src, &ssk) };
+
+        auto const hole { reinterpret_cast<Atomic<Capability> *>(~0UL) };
 
-    for (auto src { ssb }, dst { dsb }; src < sse; src++, dst++) {
+        Atomic<Captable *> *ent { nullptr };
+        Atomic<Capability> *d { nullptr };
 
-        Capability cap { obj->lookup (src) };
+        // Occupancy delta of the destination leaf table, including our reservation
+        int o { 0 };
 
-        auto const o { cap.obj() };
-        auto const p { cap.prm() & pmm };
+        // True if we hold a reservation in the destination leaf table
+        bool e { false };
 
-        if ((sts = update (dst, Capability (o, p))) != Status::SUCCESS)
-            break;
+        for (unsigned long i { 0 }; i < cnt; i++) {
+
+            // Read each source capability once, so that the same value decides the reservation and gets installed
+            Capability const src_cap { s ? Capability { s[i] } : Capability() };
+            Capability const cap { src_cap.obj(), src_cap.prm() & pmm };
+
+            // Get the destination slots, and get them again with a reservation before installing the first non-null capability
+            if (!d || (cap.prm() && !e)) {
+
+                if (d && d != hole)
+                    adjust (ent, o);
+
+                e = cap.prm();
+
+                // Allocate capability tables only for non-null capabilities
+                if (EXPECT_FALSE (!(d = walk (dst, e, ent, &dsk))))
+                    return Status::MEM_CAP;
+
+                o = -e;
+            }
+
+            // Skip the destination if it is a hole and remains one for the rest of the run
+            if (d == hole) {
+
+                // Without a source subtree, skip as far as both holes extend, which may cover many runs
+                if (!s) {
+                    cnt = min (sse - src, min (ssk, dsk));
+                    break;
+                }
+
+                continue;
+            }
+
+            o += replace (d + i, cap);
+        }
+
+        // Account for the capability changes and drop our reservation
+        if (d && d != hole)
+            adjust (ent, o);
+
+        src += cnt;
+        dst += cnt;
     }
 
-    return sts;
+    return Status::SUCCESS;
 }
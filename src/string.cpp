@@ -16,5 +16,12 @@
  * GNU General Public License version 2 for more details.
  */
 
+#include "compiler.hpp"
+#include "macros.hpp"
+#include "patch.hpp"
+
+// Emit out-of-line definitions, for calls that the compiler generates
+#undef  ALWAYS_INLINE
+#define ALWAYS_INLINE
 #define inline
 #include "string.hpp"
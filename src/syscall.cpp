@@ -21,6 +21,7 @@
  */
 
 #include "acpi.hpp"
+#include "buddy.hpp"
 #include "cos.hpp"
 #include "counter.hpp"
 #include "ec_arch.hpp"
@@ -321,7 +322,7 @@ void Ec::sys_create_sm (Ec *const self)
 {
     Sys_create_sm r { self->sys_regs() };
 
-    trace (TRACE_SYSCALL, "EC:%p %s SEL:%#lx PD:%#lx CNT:%lu", static_cast<void *>(self), __func__, r.sel(), r.pd(), r.cnt());
+    trace (TRACE_SYSCALL, "EC:%p %s SEL:%#lx PD:%#lx CNT:%lu FLG:%#x", static_cast<void *>(self), __func__, r.sel(), r.pd(), r.cnt(), r.flg());
 
     auto const obj { self->regs.get_obj() };
     auto const cpd { obj->lookup (r.pd()) };
@@ -330,7 +331,7 @@ void Ec::sys_create_sm (Ec *const self)
         self->sys_finish_status (Status::BAD_CAP);
 
     Status s;
-    Pd::create_sm (s, obj, r.sel(), r.cnt());
+    Pd::create_sm (s, obj, r.sel(), r.cnt(), ~0U, r.flg());
 
     self->sys_finish_status (s);
 }
@@ -458,12 +459,50 @@ void Ec::sys_ctrl_sm (Ec *const self)
     auto const obj { self->regs.get_obj() };
     auto const csm { obj->lookup (r.sm()) };
 
+    if (r.bind()) {         // Bind
+
+        auto const cgr { obj->lookup (r.grp()) };
+
+        if (EXPECT_FALSE (!csm.validate (Capability::Perm_sm::CTRL_DN) || !cgr.validate (Capability::Perm_sm::CTRL_DN)))
+            self->sys_finish_status (Status::BAD_CAP);
+
+        self->sys_finish_status (static_cast<Sm *>(csm.obj())->bind (static_cast<Sm *>(cgr.obj()), r.tag()));
+    }
+
     if (EXPECT_FALSE (!csm.validate (r.op() ? Capability::Perm_sm::CTRL_DN : Capability::Perm_sm::CTRL_UP)))
         self->sys_finish_status (Status::BAD_CAP);
 
     auto const sm { static_cast<Sm *>(csm.obj()) };
 
-    if (r.op()) {           // Down
+    // Group semaphores are only signaled through their members and members are only consumed through their group
+    if (EXPECT_FALSE (r.op() ? sm->is_member() : sm->is_group()))
+        self->sys_finish_status (Status::BAD_PAR);
+
+    if (r.op() && sm->is_group()) {     // Down (Group)
+
+        // Retire the member consumed by the previous down of this EC, as if it had been consumed directly
+        if (auto const m { Sm::retire (self) }) {
+
+            if (m->get_id() != ~0U) {
+
+                Interrupt::Config cfg { Interrupt::int_table[m->get_id()].config };
+
+                if (Cpu::id != cfg.cpu()) {
+                    Sm::unretire (self, m);
+                    self->sys_finish_status (Status::BAD_CPU);
+                }
+
+                // Guest-assigned interrupts are deactivated by the guest
+                if (!cfg.gst())
+                    Interrupt::deactivate (m->get_id());
+            }
+
+            m->release();
+        }
+
+        r.set_tag (sm->dn_group (self, r.zc(), r.time_ticks())->get_tag());
+
+    } else if (r.op()) {    // Down
 
         auto const id { sm->get_id() };
 
@@ -479,7 +518,9 @@ void Ec::sys_ctrl_sm (Ec *const self)
                 Interrupt::deactivate (id);
         }
 
-        sm->dn (self, r.zc(), r.time_ticks());
+        // The semaphore was bound to a group concurrently
+        if (EXPECT_FALSE (!sm->dn (self, r.zc(), r.time_ticks())))
+            self->sys_finish_status (Status::BAD_PAR);
 
     } else if (!sm->up())   // Up
         self->sys_finish_status (Status::OVRFLOW);
@@ -487,6 +528,16 @@ void Ec::sys_ctrl_sm (Ec *const self)
     self->sys_finish_status (Status::SUCCESS);
 }
 
+/*
+ * Retry a down operation on a group semaphore after a wakeup
+ */
+void Ec::sys_ctrl_sm_retry (Ec *const self)
+{
+    self->clr_timeout();
+
+    sys_ctrl_sm (self);
+}
+
 void Ec::sys_ctrl_hw (Ec *const self)
 {
     Sys_ctrl_hw r { self->sys_regs() };
@@ -503,6 +554,37 @@ void Ec::sys_ctrl_hw (Ec *const self)
         default:            // Invalid Operation
             self->sys_finish_status (Status::BAD_PAR);
 
+        case 10:            // Kernel Memory Reclaim
+            self->sys_finish_status (Buddy::reclaim (r.phys()) ? Status::SUCCESS : Status::BAD_PAR);
+
+        /*
+         * The caller must have revoked all user and device mappings of the range
+         * from every PD before donating it. The kernel only revokes the access that
+         * the root PD derives its mappings from, and it has no mapping database to
+         * find or revoke mappings that were delegated from there. Any remaining
+         * mapping retains access to what becomes kernel memory.
+         */
+        case 9:             // Kernel Memory Donation
+            self->sys_finish_status (Buddy::donate (r.phys(), r.size()) ? Status::SUCCESS : Status::BAD_PAR);
+
+        case 8: {           // PD Kernel Memory Quota
+            auto const cpd { obj->lookup (r.desc()) };
+
+            if (EXPECT_FALSE (!cpd.validate (Capability::Perm_pd::PD)))
+                self->sys_finish_status (Status::BAD_CAP);
+
+            auto &q { static_cast<Pd *>(cpd.obj())->get_quota() };
+
+            // A limit of 0 leaves the current limit unchanged
+            if (r.limit())
+                q.set_limit (r.limit());
+
+            r.set_used (q.get_used());
+            r.set_limit (q.get_limit());
+
+            self->sys_finish_status (Status::SUCCESS);
+        }
+
         case 7:             // MBA L2 Delay
             self->sys_finish_status (Cos::cfg_mb_thrt (static_cast<uint16_t>(r.desc()), static_cast<uint16_t>(r.desc() >> 16)));
 
@@ -536,23 +618,31 @@ void Ec::sys_assign_int (Ec *const self)
 {
     Sys_assign_int r { self->sys_regs() };
 
-    trace (TRACE_SYSCALL, "EC:%p %s SM:%#lx CPU:%u FLG:%#x", static_cast<void *>(self), __func__, r.sm(), r.cpu(), r.flg());
+    trace (TRACE_SYSCALL, "EC:%p %s SM:%#lx CPU:%u FLG:%#x ITV:%lu BAT:%u DSW:%u", static_cast<void *>(self), __func__, r.sm(), r.cpu(), r.flg(), r.itv(), r.bat(), r.dsw());
 
     if (EXPECT_FALSE (r.cpu() >= Cpu::count))
         self->sys_finish_status (Status::BAD_CPU);
 
+    // A batch count requires an interval that delivers an incomplete batch
+    if (EXPECT_FALSE (r.bat() && !r.itv()))
+        self->sys_finish_status (Status::BAD_PAR);
+
     auto const obj { self->regs.get_obj() };
     auto const csm { obj->lookup (r.sm()) };
 
     if (EXPECT_FALSE (!csm.validate (Capability::Perm_sm::ASSIGN)))
         self->sys_finish_status (Status::BAD_CAP);
 
-    assert (static_cast<Sm *>(csm.obj())->get_id() != ~0U);
+    auto const id { static_cast<Sm *>(csm.obj())->get_id() };
+
+    assert (id != ~0U);
 
     uint32_t msi_addr;
     uint16_t msi_data;
 
-    Interrupt::configure (static_cast<Sm *>(csm.obj())->get_id(), Interrupt::Config (r.cpu(), r.dev(), r.flg()), msi_addr, msi_data);
+    Interrupt::int_table[id].timeout.configure (r.itv(), r.bat(), r.dsw());
+
+    Interrupt::configure (id, Interrupt::Config (r.cpu(), r.dev(), r.flg()), msi_addr, msi_data);
 
     r.set_msi_addr (msi_addr);
     r.set_msi_data (msi_data);
@@ -581,7 +671,11 @@ void Ec::sys_assign_dev (Ec *const self)
     if (EXPECT_FALSE (!smmu))
         self->sys_finish_status (Status::BAD_DEV);
 
-    if (EXPECT_FALSE (!smmu->configure (static_cast<Space_dma *>(csp.obj()), r.dad())))
+    auto const dma { static_cast<Space_dma *>(csp.obj()) };
+
+    dma->set_used();
+
+    if (EXPECT_FALSE (!smmu->configure (dma, r.dad())))
         self->sys_finish_status (Status::BAD_PAR);
 
     self->sys_finish_status (Status::SUCCESS);
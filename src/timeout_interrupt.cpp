@@ -0,0 +1,104 @@
+/*
+ * Interrupt Moderation Timeout
+ *
+ * Copyright (C) 2019-2024 Udo Steinberg, BedRock Systems, Inc.
+ *
+ * This file is part of the NOVA microhypervisor.
+ *
+ * NOVA is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NOVA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License version 2 for more details.
+ */
+
+#include "interrupt.hpp"
+#include "sm.hpp"
+#include "timeout_interrupt.hpp"
+#include "timer.hpp"
+
+/*
+ * Signal the semaphore once for each accumulated interrupt
+ *
+ * Only the first up wakes a waiter; the remaining interrupts accumulate in
+ * the semaphore counter, where the woken EC finds them without blocking.
+ *
+ * @param t     Current time
+ */
+void Timeout_interrupt::flush (uint64_t t)
+{
+    auto n { cnt.load() };
+
+    while (n && !cnt.compare_exchange_n (n, 0)) ;
+
+    if (!n)
+        return;
+
+    last = t;
+
+    for (auto d { dsw.load() }; n--; d = false)
+        irq->sm->up (d);
+}
+
+void Timeout_interrupt::trigger()
+{
+    armed = false;
+
+    flush (Timer::time());
+}
+
+/*
+ * Configure interrupt moderation
+ *
+ * Interrupts that accumulated under the previous configuration are
+ * delivered immediately.
+ *
+ * @param i     Minimum inter-wakeup interval in ticks (or 0 for none)
+ * @param b     Batch count (or 0 for none)
+ * @param d     True to switch directly to the woken EC
+ */
+void Timeout_interrupt::configure (uint64_t i, uint32_t b, bool d)
+{
+    itv = i;
+    bat = b;
+    dsw = d;
+
+    flush (Timer::time());
+}
+
+/*
+ * Account an interrupt and signal the semaphore if moderation permits
+ *
+ * Must be called on the CPU to which the interrupt is routed.
+ */
+void Timeout_interrupt::signal()
+{
+    auto const i { itv.load() };
+    auto const b { bat.load() };
+
+    // No moderation
+    if (EXPECT_TRUE (!i && !b)) {
+        irq->sm->up (dsw);
+        return;
+    }
+
+    auto const n { ++cnt };
+    auto const t { Timer::time() };
+
+    // Batch complete or interval elapsed since the most recent wakeup
+    if ((b && n >= b) || (i && t >= last + i)) {
+        flush (t);
+        return;
+    }
+
+    // Deliver the remainder at the end of the current window
+    if (bool o { false }; armed.compare_exchange_n (o, true))
+        Timeout::enqueue (last + i);
+
+    // Reenable an edge-triggered interrupt, so that further interrupts accumulate
+    if (!irq->config.load().trg())
+        Interrupt::deactivate (static_cast<unsigned>(irq - Interrupt::int_table));
+}
@@ -413,6 +413,11 @@ void Cpu::init()
         Space_hst::nova.loc[id] = Hptp::current();
         Space_hst::nova.loc[id].lookup (MMAP_CPU_DATA, phys, o, ma);
         Hptp::master_map (MMAP_GLB_CPUS + id * PAGE_SIZE (0), phys, 0, Paging::Permissions (Paging::G | Paging::W | Paging::R), ma);
+
+        // Report the page sizes that back the kernel mappings
+        unsigned n[Hpt::lev()] { 0 };
+        Space_hst::nova.loc[id].census (LINK_ADDR, MMAP_CPU + PAGE_SIZE (1), n);
+        trace (TRACE_MEMORY, "KMAP: CPU:%u 4K:%u 2M:%u 1G:%u", id, n[0], n[1], n[2]);
     }
 
     setup_msr();
@@ -23,12 +23,16 @@
 #include "event.hpp"
 #include "fpu.hpp"
 #include "hip.hpp"
+#include "interrupt.hpp"
 #include "pd.hpp"
 #include "rcu.hpp"
 #include "space_gst.hpp"
 #include "stdio.hpp"
 #include "vpid.hpp"
 
+INIT_PRIORITY (PRIO_LOCAL) Queue<Ec> Ec_arch::vmcs_queue;
+INIT_PRIORITY (PRIO_LOCAL) Spinlock  Ec_arch::vmcs_lock;
+
 // Constructor: Kernel Thread
 Ec_arch::Ec_arch (Refptr<Space_obj> &ref_obj, Refptr<Space_hst> &ref_hst, Refptr<Space_pio> &ref_pio, cpu_t c, cont_t x) : Ec { ref_obj, ref_hst, ref_pio, c, x } {}
 
@@ -153,22 +157,36 @@ Ec *Ec::create_gst (Status &s, Pd *pd, bool t, bool fpu, cpu_t cpu, unsigned lon
 
     if (has_vmx) {
 
+        auto const q { pd->get_quota().charge (PAGE_SIZE (0)) };
         auto const v { new Vmcs };
-        auto const k { Buddy::alloc (0, Buddy::Fill::BITS0) };
+        auto const k { q ? Buddy::alloc (0, Buddy::Fill::BITS0) : nullptr };
+
+        if (EXPECT_TRUE ((!fpu || f) && v && k && (ec = new (pd->ec_cache) Ec_arch { t, f, ref_obj, ref_hst, v, cpu, evt, sp, hva, k }))) {
 
-        if (EXPECT_TRUE ((!fpu || f) && v && k && (ec = new (cache) Ec_arch { t, f, ref_obj, ref_hst, v, cpu, evt, sp, hva, k }))) {
             assert (!ref_obj && !ref_hst);
-            return ec;
+
+            if (EXPECT_TRUE (ec->kpage_mapped (hva)))
+                return ec;
+
+            // The address was already taken by the kernel page of another EC
+            ec->destroy();
+            Buddy::free (k);
+            pd->get_quota().uncharge (PAGE_SIZE (0));
+            s = Status::BAD_PAR;
+            return nullptr;
         }
 
         Buddy::free (k);
         delete v;
 
+        if (q)
+            pd->get_quota().uncharge (PAGE_SIZE (0));
+
     } else if (has_svm) {
 
         auto const v { new Vmcb };
 
-        if (EXPECT_TRUE ((!fpu || f) && v && (ec = new (cache) Ec_arch { t, f, ref_obj, ref_hst, v, cpu, evt, sp }))) {
+        if (EXPECT_TRUE ((!fpu || f) && v && (ec = new (pd->ec_cache) Ec_arch { t, f, ref_obj, ref_hst, v, cpu, evt, sp }))) {
             assert (!ref_obj && !ref_hst);
             return ec;
         }
@@ -183,6 +201,69 @@ Ec *Ec::create_gst (Status &s, Pd *pd, bool t, bool fpu, cpu_t cpu, unsigned lon
     return nullptr;
 }
 
+/*
+ * Determine if the VMCS of this unused vCPU may still be active on its CPU
+ *
+ * VMCLEAR must execute on the CPU on which the VMCS is active, so the first
+ * check queues the vCPU on that CPU and kicks it to clear the VMCS.
+ *
+ * @return      True if the VMCS may still be active, false otherwise
+ */
+bool Ec_arch::vcpu_busy()
+{
+    if (!Hip::feature (Hip_arch::Feature::VMX))
+        return false;
+
+    bool notify;
+
+    {   Lock_guard <Spinlock> guard { *Kmem::loc_to_glob (cpu, &vmcs_lock) };
+
+        if (vmcs_inactive)
+            return false;
+
+        if (queued())
+            return true;
+
+        notify = Kmem::loc_to_glob (cpu, &vmcs_queue)->enqueue_tail (this);
+    }
+
+    if (notify)
+        Interrupt::send_cpu (Interrupt::Request::RKE, cpu);
+
+    return true;
+}
+
+/*
+ * Clear the VMCSs of the unused vCPUs queued on this CPU
+ */
+void Ec_arch::clear_vmcs()
+{
+    // The CPU that queued a vCPU kicks this CPU afterwards
+    if (EXPECT_TRUE (vmcs_queue.empty()))
+        return;
+
+    Lock_guard <Spinlock> guard { vmcs_lock };
+
+    for (Ec *ec; (ec = vmcs_queue.dequeue_head()); ) {
+
+        auto const e { static_cast<Ec_arch *>(ec) };
+
+        e->regs.vmcs->clear();
+        e->vmcs_inactive = true;
+    }
+}
+
+/*
+ * Free the VMCS or VMCB of this vCPU
+ */
+void Ec_arch::vcpu_fini()
+{
+    if (Hip::feature (Hip_arch::Feature::VMX))
+        delete regs.vmcs;
+    else
+        delete regs.vmcb;
+}
+
 void Ec::adjust_offset_ticks (uint64_t t)
 {
     if (subtype == Kobject::Subtype::EC_VCPU_OFFS) {
@@ -300,6 +381,8 @@ void Ec_arch::ret_user_vmexit_vmx (Ec *const self)
     Cpu::State_tsc::make_current (Cpu::hst_tsc, self->regs.gst_tsc);    // Restore TSC guest state
     Fpu::State_xsv::make_current (Fpu::hst_xsv, self->regs.gst_xsv);    // Restore XSV guest state
 
+    Rcu::eqs_enter();
+
     asm volatile ("lea %0, %%rsp;"
                   EXPAND (LOAD_GPR)
                   "vmresume;"
@@ -327,6 +410,8 @@ void Ec_arch::ret_user_vmexit_svm (Ec *const self)
     Cpu::State_tsc::make_current (Cpu::hst_tsc, self->regs.gst_tsc);    // Restore TSC guest state
     Fpu::State_xsv::make_current (Fpu::hst_xsv, self->regs.gst_xsv);    // Restore XSV guest state
 
+    Rcu::eqs_enter();
+
     asm volatile ("lea %0, %%rsp;"
                   EXPAND (LOAD_GPR)
                   "clgi;"
@@ -20,6 +20,7 @@
  */
 
 #include "ec_arch.hpp"
+#include "rcu.hpp"
 #include "svm.hpp"
 
 void Ec_arch::svm_exception (uint64_t reason)
@@ -52,6 +53,8 @@ void Ec_arch::handle_svm()
 {
     Ec *const self = current;
 
+    Rcu::eqs_exit();
+
     Cpu::State_tsc::make_current (self->regs.gst_tsc, Cpu::hst_tsc);    // Restore TSC host state
     Fpu::State_xsv::make_current (self->regs.gst_xsv, Fpu::hst_xsv);    // Restore XSV host state
 
@@ -22,6 +22,7 @@
 #include "counter.hpp"
 #include "ec_arch.hpp"
 #include "interrupt.hpp"
+#include "rcu.hpp"
 #include "stdio.hpp"
 #include "vmx.hpp"
 
@@ -70,6 +71,8 @@ void Ec_arch::handle_vmx()
 {
     Ec *const self { current };
 
+    Rcu::eqs_exit();
+
     // IA32_KERNEL_GS_BASE can change without VM exit due to SWAPGS
     self->regs.gst_sys.kernel_gs_base = Msr::read (Msr::Reg64::IA32_KERNEL_GS_BASE);
 
@@ -95,6 +98,8 @@ void Ec_arch::failed_vmx()
 {
     Ec *const self { current };
 
+    Rcu::eqs_exit();
+
     Cpu::State_sys::make_current (self->regs.gst_sys, Cpu::hst_sys);    // Restore SYS host state
     Cpu::State_tsc::make_current (self->regs.gst_tsc, Cpu::hst_tsc);    // Restore TSC host state
     Fpu::State_xsv::make_current (self->regs.gst_xsv, Fpu::hst_xsv);    // Restore XSV host state
@@ -21,10 +21,12 @@
 
 #include "acpi.hpp"
 #include "counter.hpp"
+#include "ec_arch.hpp"
 #include "idt.hpp"
 #include "interrupt.hpp"
 #include "ioapic.hpp"
 #include "lapic.hpp"
+#include "rcu.hpp"
 #include "sm.hpp"
 #include "smmu.hpp"
 #include "space_hst.hpp"
@@ -60,6 +62,10 @@ void Interrupt::rke_handler()
 
     if (Space_hst::current->htlb.tst (Cpu::id))
         Cpu::hazard |= Hazard::SCHED;
+
+    Ec_arch::clear_vmcs();
+
+    Rcu::check();
 }
 
 void Interrupt::handle_ipi (unsigned ipi)
@@ -94,7 +100,7 @@ void Interrupt::handle_gsi (unsigned gsi)
 
     set_mask (gsi, true);
 
-    int_table[gsi].sm->up();
+    int_table[gsi].timeout.signal();
 }
 
 void Interrupt::handler (unsigned v)
@@ -175,3 +181,8 @@ void Interrupt::send_exc (Request req)
 {
     Lapic::send_exc (VEC_IPI + req);
 }
+
+void Interrupt::send_set (Request req, Cpuset const &set)
+{
+    Lapic::send_set (VEC_IPI + req, set);
+}
@@ -45,6 +45,7 @@ void Patch::detect()
                 }
             }
             skipped |= !!(edx & BIT (20)) * BIT (PATCH_CET_IBT);
+            skipped |= !!(ebx & BIT (9) || edx & BIT (4)) * BIT (PATCH_ERMS);
             Cpu::cpuid (0x7, 0x1, eax, ebx, ecx, edx);
             skipped |= !!(edx & BIT (18)) * BIT (PATCH_CET_SSS);
             [[fallthrough]];
@@ -81,10 +82,16 @@ void Patch::init()
         if (skipped & BIT (p->tag))
             continue;
 
-        auto const o { reinterpret_cast<uint8_t *>(p) + p->off_old };
-        auto const n { reinterpret_cast<uint8_t *>(p) + p->off_new };
+        auto const o { reinterpret_cast<uint8_t volatile *>(p) + p->off_old };
+        auto const n { reinterpret_cast<uint8_t volatile *>(p) + p->off_new };
 
-        memcpy (o, n, p->len_new);
-        memset (o + p->len_new, NOP_OPC, p->len_old - p->len_new);
+        // Copy byte-wise, because memcpy and memset are patch sites themselves
+        unsigned i { 0 };
+
+        for (; i < p->len_new; i++)
+            o[i] = n[i];
+
+        for (; i < p->len_old; i++)
+            o[i] = NOP_OPC;
     }
 }
@@ -0,0 +1,76 @@
+/*
+ * String Function Performance
+ *
+ * Copyright (C) 2019-2024 Udo Steinberg, BedRock Systems, Inc.
+ *
+ * This file is part of the NOVA microhypervisor.
+ *
+ * NOVA is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * NOVA is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License version 2 for more details.
+ */
+
+#include "buddy.hpp"
+#include "stc.hpp"
+#include "stdio.hpp"
+#include "string.hpp"
+#include "string_perf.hpp"
+#include "timer.hpp"
+
+/*
+ * Measure a variant
+ *
+ * @param f         Function that processes the buffer once
+ * @return          Time for all passes in STC ticks
+ */
+template <typename F>
+uint64_t String_perf::measure (F const &f)
+{
+    // Warm up the caches and the TLB
+    f();
+
+    auto const t { Timer::time() };
+
+    for (unsigned i { 0 }; i < reps; i++) {
+        f();
+
+        // Keep the compiler from merging passes
+        asm volatile ("" : : : "memory");
+    }
+
+    return Timer::time() - t;
+}
+
+/*
+ * Report the time of each variant, independent of which variant is patched in
+ */
+void String_perf::report()
+{
+    auto const d { Buddy::alloc (ord) };
+    auto const s { Buddy::alloc (ord) };
+
+    if (EXPECT_TRUE (d && s)) {
+
+        size_t const n { BIT (ord + PAGE_BITS) };
+
+        auto const cb { measure ([&] { void *x { d }; void const *y { s }; size_t c { n }; asm volatile (EXPAND (ASM_MEMCPY_0) : "+D" (x), "+S" (y), "+c" (c) : : "rdx", "memory"); }) };
+        auto const cq { measure ([&] { void *x { d }; void const *y { s }; size_t c { n }; asm volatile (EXPAND (ASM_MEMCPY_1) : "+D" (x), "+S" (y), "+c" (c) : : "rdx", "memory"); }) };
+        auto const sb { measure ([&] { void *x { d }; size_t c { n }; asm volatile (EXPAND (ASM_MEMSET_0) : "+D" (x), "+c" (c) : "a" (0UL) : "rdx", "memory"); }) };
+        auto const sq { measure ([&] { void *x { d }; size_t c { n }; asm volatile (EXPAND (ASM_MEMSET_1) : "+D" (x), "+c" (c) : "a" (0UL) : "rdx", "memory"); }) };
+        auto const zn { measure ([&] { memzero (d, n); }) };
+
+        trace (TRACE_PERF, "STRING: %luKiB MEMCPY B:%luus Q:%luus MEMSET B:%luus Q:%luus MEMZERO NT:%luus",
+               reps * n >> 10,
+               Stc::ticks_to_us (cb), Stc::ticks_to_us (cq),
+               Stc::ticks_to_us (sb), Stc::ticks_to_us (sq),
+               Stc::ticks_to_us (zn));
+    }
+
+    Buddy::free (d);
+    Buddy::free (s);
+}
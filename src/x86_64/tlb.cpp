@@ -20,6 +20,7 @@
  */
 
 #include "counter.hpp"
+#include "cpuset.hpp"
 #include "ec.hpp"
 #include "interrupt.hpp"
 #include "space_gst.hpp"
@@ -33,6 +34,11 @@ void Tlb::shootdown (Space *s)
 {
     Cpu::preemption_enable();
 
+    Cpuset tgt;
+
+    unsigned req[NUM_CPU], n { 0 };
+
+    // Determine the remote CPUs that run the space and snapshot their request counters
     for (cpu_t cpu { 0 }; cpu < Cpu::count; cpu++) {
 
         auto const ec { Ec::remote_current (cpu) };
@@ -45,12 +51,21 @@ void Tlb::shootdown (Space *s)
             continue;
         }
 
-        auto const c { Counter::req[Interrupt::Request::RKE].get (cpu) };
+        req[cpu] = Counter::req[Interrupt::Request::RKE].get (cpu);
 
-        Interrupt::send_cpu (Interrupt::Request::RKE, cpu);
+        tgt.tas (cpu);
 
-        Wait::until (1, [&] { return Counter::req[Interrupt::Request::RKE].get (cpu) != c; });
+        n++;
     }
 
+    // Send all IPIs first, broadcasting if all remote CPUs run the space
+    if (n)
+        n == Cpu::count - 1u ? Interrupt::send_exc (Interrupt::Request::RKE) : Interrupt::send_set (Interrupt::Request::RKE, tgt);
+
+    // Then wait for all acknowledgements together
+    for (cpu_t cpu { 0 }; n && cpu < Cpu::count; cpu++)
+        if (tgt.tst (cpu))
+            Wait::until (1, [&] { return Counter::req[Interrupt::Request::RKE].get (cpu) != req[cpu]; });
+
     Cpu::preemption_disable();
 }